@@ -4,10 +4,26 @@
 // include & namespace
 ////////////////////////////////////////
 #include <vector>
+#include <tuple>
+#include <algorithm>
 #include <tdzdd/util/Graph.hpp>
 using namespace tdzdd;
 
 
+////////////////////////////////////////
+// Edge Order
+//   Given       : the order of the input
+//   RowMajor    : top to bottom, left to right
+//   ColumnMajor : left to right, top to bottom
+//   Diagonal    : along anti-diagonals from the top-left corner
+//   MinWidth    : greedy, add an edge that keeps the frontier smallest
+//   Best        : the one with the smallest width among the above
+////////////////////////////////////////
+enum class EdgeOrder : int {Given=0, RowMajor, ColumnMajor, Diagonal, MinWidth, Best};
+
+static const char* EdgeOrderNames[] = {"given", "row", "column", "diagonal", "minwidth", "best"};
+
+
 ////////////////////////////////////////
 // Frontier Manager
 ////////////////////////////////////////
@@ -19,6 +35,7 @@ class FrontierManager {
  private:
 
   typedef std::pair<int, int> Edge;
+  typedef std::pair<int, int> Point; // (x, y)
 
 
   ////////////////////////////////////////
@@ -31,6 +48,8 @@ class FrontierManager {
   const int m;          // # edges
   int w;                // Width = Maximum Frontier Size
   std::vector<Edge> EL; // EdgeList
+  std::vector<int> EI;  // original index of EL[k]
+  EdgeOrder order;      // order of EL
 
   // Frontier
   std::vector<std::vector<int> > Es; // Entering vertices
@@ -50,13 +69,17 @@ class FrontierManager {
 
   // construct from EL
   FrontierManager(const int n, const std::vector<Edge>& EL) :
-      n(n), m(EL.size()), EL(EL)
+      n(n), m(EL.size()), EL(EL), order(EdgeOrder::Given)
   {
+    for (int k = 0; k < m; ++k) {
+      EI.push_back(k);
+    }
     initialize();
   }
 
   // construct from G
-  FrontierManager(const tdzdd::Graph& G) : n(G.vertexSize()), m(G.edgeSize())
+  FrontierManager(const tdzdd::Graph& G) :
+      n(G.vertexSize()), m(G.edgeSize()), order(EdgeOrder::Given)
   {
     // initialize EL
     for (int i = 0; i < m; ++i){
@@ -64,6 +87,46 @@ class FrontierManager {
       const int v1 = e.v1;
       const int v2 = e.v2;
       EL.push_back( Edge(v1, v2) );
+      EI.push_back(i);
+    }
+
+    // initialize Vertex Sets & Maps
+    initialize();
+  }
+
+  // construct from G with vertex coordinates XY[v] and an edge order
+  FrontierManager(const tdzdd::Graph& G, const std::vector<Point>& XY, const EdgeOrder ord) :
+      n(G.vertexSize()), m(G.edgeSize()), order(ord)
+  {
+    // edges of G
+    std::vector<Edge> GL;
+    for (int i = 0; i < m; ++i){
+      const tdzdd::Graph::EdgeInfo& e = G.edgeInfo(i);
+      GL.push_back( Edge(e.v1, e.v2) );
+    }
+
+    // choose an order
+    if (order == EdgeOrder::Best) {
+      const EdgeOrder cands[] = {EdgeOrder::RowMajor, EdgeOrder::ColumnMajor,
+                                 EdgeOrder::Diagonal, EdgeOrder::MinWidth};
+      int best = -1;
+      for (const EdgeOrder c : cands) {
+        std::vector<int> I = getOrder(n, GL, XY, c);
+        const int cw = getWidth(n, GL, I);
+        if (best < 0 || cw < best) {
+          best = cw;
+          order = c;
+          EI = I;
+        }
+      }
+    }
+    else {
+      EI = getOrder(n, GL, XY, order);
+    }
+
+    // initialize EL
+    for (int k = 0; k < m; ++k) {
+      EL.push_back( GL[ EI[k] ] );
     }
 
     // initialize Vertex Sets & Maps
@@ -71,6 +134,143 @@ class FrontierManager {
   }
 
 
+  ////////////////////////////////////////
+  // edge orders
+  ////////////////////////////////////////
+ private:
+
+  // the k-th edge of the order is GL[I[k]]
+  static std::vector<int> getOrder(const int n, const std::vector<Edge>& GL,
+                                   const std::vector<Point>& XY, const EdgeOrder ord)
+  {
+    std::vector<int> I;
+    for (int i = 0; i < GL.size(); ++i) {
+      I.push_back(i);
+    }
+
+    if (ord == EdgeOrder::MinWidth) {
+      return getMinWidthOrder(n, GL);
+    }
+    if (ord == EdgeOrder::Given || ord == EdgeOrder::Best) {
+      return I;
+    }
+
+    // sort by the upper-left endpoint
+    std::vector<std::tuple<int, int, int> > keys;
+    for (int i = 0; i < GL.size(); ++i) {
+      const Point& p = std::min(XY[GL[i].first], XY[GL[i].second],
+                                [](const Point& a, const Point& b) {
+                                  return std::make_pair(a.second, a.first) < std::make_pair(b.second, b.first);
+                                });
+      const int x = p.first;
+      const int y = p.second;
+      const bool horizontal = (XY[GL[i].first].second == XY[GL[i].second].second);
+      switch (ord) {
+        case EdgeOrder::RowMajor:
+          keys.push_back( std::make_tuple(y, x, horizontal ? 0 : 1) );
+          break;
+        case EdgeOrder::ColumnMajor:
+          keys.push_back( std::make_tuple(x, y, horizontal ? 1 : 0) );
+          break;
+        default:
+          keys.push_back( std::make_tuple(x + y, x, horizontal ? 0 : 1) );
+          break;
+      }
+    }
+    std::stable_sort(I.begin(), I.end(), [&keys](const int i, const int j) {
+        return keys[i] < keys[j];
+      });
+
+    return I;
+  }
+
+  // greedy : add an edge that enters the fewest and leaves the most vertices
+  static std::vector<int> getMinWidthOrder(const int n, const std::vector<Edge>& GL)
+  {
+    const int m = GL.size();
+    std::vector<int> deg(n + 1, 0);   // # remaining edges
+    std::vector<bool> in(n + 1, false);
+    std::vector<bool> used(m, false);
+    std::vector<std::vector<int> > inc(n + 1);
+    for (int i = 0; i < m; ++i) {
+      deg[ GL[i].first ]++;
+      deg[ GL[i].second ]++;
+      inc[ GL[i].first ].push_back(i);
+      inc[ GL[i].second ].push_back(i);
+    }
+
+    std::vector<int> I;
+    std::vector<int> F; // frontier
+    while (I.size() < m) {
+      // candidates : edges incident to the frontier, or the first unused edge
+      int best = -1;
+      int best_score = 0;
+      for (int j = 0; j < F.size(); ++j) {
+        for (const int i : inc[ F[j] ]) {
+          if (used[i]) continue;
+          const int u = GL[i].first;
+          const int v = GL[i].second;
+          const int score = (in[u] ? 0 : 1) + (in[v] ? 0 : 1)
+              - (deg[u] == 1 ? 1 : 0) - (deg[v] == 1 ? 1 : 0);
+          if (best < 0 || score < best_score || (score == best_score && i < best)) {
+            best = i;
+            best_score = score;
+          }
+        }
+      }
+      if (best < 0) {
+        best = std::find(used.begin(), used.end(), false) - used.begin();
+      }
+
+      // add the edge
+      used[best] = true;
+      I.push_back(best);
+      const int vs[] = {GL[best].first, GL[best].second};
+      for (const int v : vs) {
+        if (!in[v]) {
+          in[v] = true;
+          F.push_back(v);
+        }
+        if (--deg[v] == 0) {
+          F.erase(std::find(F.begin(), F.end(), v));
+        }
+      }
+    }
+
+    return I;
+  }
+
+  // max frontier size of the order I
+  static int getWidth(const int n, const std::vector<Edge>& GL, const std::vector<int>& I)
+  {
+    std::vector<int> last(n + 1, -1);
+    for (int k = 0; k < I.size(); ++k) {
+      last[ GL[I[k]].first ] = k;
+      last[ GL[I[k]].second ] = k;
+    }
+
+    int size = 0, width = 0;
+    std::vector<bool> in(n + 1, false);
+    for (int k = 0; k < I.size(); ++k) {
+      const int vs[] = {GL[I[k]].first, GL[I[k]].second};
+      for (const int v : vs) {
+        if (!in[v]) {
+          in[v] = true;
+          size++;
+        }
+      }
+      width = std::max(width, size);
+      for (const int v : vs) {
+        if (last[v] == k) {
+          size--;
+        }
+      }
+    }
+
+    return width;
+  }
+
+
   ////////////////////////////////////////
   // construct Vertex Sets & Maps
   ////////////////////////////////////////
@@ -243,6 +443,11 @@ class FrontierManager {
     return this->w;
   }
 
+  EdgeOrder getOrder() const
+  {
+    return this->order;
+  }
+
 
   ////////////////////////////////////////
   // get edge info: eid, edge, v1, v2 of level, width W
@@ -264,6 +469,22 @@ class FrontierManager {
     return this->EL;
   }
 
+  // index of the edge of level in the input
+  int getOriginalEdgeId(const int level) const
+  {
+    return this->EI[ this->getEdgeId(level) ];
+  }
+
+  // getOriginalEdgeId for all levels
+  std::vector<int> getOriginalEdgeIds(void) const
+  {
+    std::vector<int> I(this->m + 1, -1);
+    for (int level = this->m; level > 0; --level) {
+      I[level] = this->getOriginalEdgeId(level);
+    }
+    return I;
+  }
+
   int getV1(const int level) const
   {
     return this->EL[ this->getEdgeId(level) ].first;
@@ -327,6 +548,7 @@ class FrontierManager {
     os << "n = " << this->n << std::endl;
     os << "m = " << this->m << std::endl;
     os << "w = " << this->w << std::endl;
+    os << "order = " << EdgeOrderNames[ static_cast<int>(this->order) ] << std::endl;
 
     for (int level = this->m; level > 0; --level) {
       const int k = getEdgeId(level);
@@ -0,0 +1,466 @@
+#pragma once
+
+////////////////////////////////////////
+// include
+////////////////////////////////////////
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <glob.h>
+#include <sys/stat.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <tdzdd/DdStructure.hpp>
+#include <tdzdd/util/Graph.hpp>
+
+#include "NagareruSpec.hpp"
+#include "NagareruProblem.hpp"
+#include "NagareruCorpus.hpp"
+#include "NagareruReader.hpp"
+
+
+////////////////////////////////////////
+// namespace
+////////////////////////////////////////
+namespace nagareru
+{
+
+
+////////////////////////////////////////
+// result of solving one problem file
+////////////////////////////////////////
+struct SolveRecord {
+  std::string file;
+  std::string error;       // empty if solved
+  int W = 0;               // width
+  int H = 0;               // height
+  int nodes = 0;           // # board nodes
+  int edges = 0;           // # board edges
+  int width = 0;           // frontier width
+  std::string order;       // edge order
+  size_t zdd_nodes = 0;    // # zdd nodes (non-reduced)
+  size_t zdd_reduced = 0;  // # zdd nodes (reduced)
+  std::string solutions;   // # solutions
+
+  // seconds of each phase
+  double t_parse = 0;
+  double t_graph = 0;
+  double t_frontier = 0;   // NagareruSpec (FrontierManager) construction
+  double t_construct = 0;
+  double t_reduce = 0;
+  double t_cardinality = 0;
+};
+
+
+////////////////////////////////////////
+// header of a problem file
+////////////////////////////////////////
+
+// the first n lines of file without "\r" (empty lines if it is shorter)
+std::vector<std::string> getHeadLines(const std::string& file, const int n)
+{
+  std::ifstream ifs(file);
+  std::vector<std::string> lines(n);
+  for (int k = 0; k < n && ifs && getline(ifs, lines[k]); ++k) {
+    if (!lines[k].empty() && lines[k].back() == '\r') lines[k].pop_back();
+  }
+  return lines;
+}
+
+// does file start with a "pzprv3" line
+bool isPzprvFile(const std::string& file)
+{
+  return getHeadLines(file, 1)[0] == "pzprv3";
+}
+
+// an error message if file does not start with "pzprv3" and "nagare" lines (empty if it does)
+std::string checkNagareHeader(const std::string& file)
+{
+  std::ifstream ifs(file);
+  if (!ifs) return "cannot open " + file;
+  const std::vector<std::string> lines = getHeadLines(file, 2);
+  if (lines[0] != "pzprv3") return file + " : line 1 : no pzprv3 header";
+  if (lines[1] != "nagare") return file + " : line 2 : not a nagare puzzle : " + lines[1];
+  return "";
+}
+
+
+////////////////////////////////////////
+// solve a problem given by parse() without any output
+////////////////////////////////////////
+template <class Parse>
+SolveRecord solveProblem(const std::string& name, const Parse& parse, const EdgeOrder order, const size_t mem_limit)
+{
+  typedef std::chrono::steady_clock clock;
+  SolveRecord r;
+  r.file = name;
+
+  try {
+    clock::time_point t = clock::now();
+    const auto lap = [&t]() {
+      const clock::time_point s = clock::now();
+      const std::chrono::duration<double> d = s - t;
+      t = s;
+      return d.count();
+    };
+
+    // parse
+    const NagareruProblem P = parse();
+    r.W = P.getW();
+    r.H = P.getH();
+    r.t_parse = lap();
+
+    // graph
+    const tdzdd::Graph G = P.getGraph();
+    r.nodes = G.vertexSize();
+    r.edges = G.edgeSize();
+    r.t_graph = lap();
+
+    // frontier
+    NagareruSpec spec(P, G, order);
+    MemoryBudget budget(mem_limit);
+    if (mem_limit > 0) spec.setMemoryBudget(&budget);
+    r.width = spec.getFrontierManager().getWidth();
+    r.order = EdgeOrderNames[ static_cast<int>(spec.getFrontierManager().getOrder()) ];
+    r.t_frontier = lap();
+
+    // zdd
+    tdzdd::DdStructure<2> Z(spec, false);
+    r.zdd_nodes = Z.size();
+    r.t_construct = lap();
+    if (budget.isExceeded()) throw MemoryLimitExceeded();
+    Z.zddReduce();
+    r.zdd_reduced = Z.size();
+    r.t_reduce = lap();
+    r.solutions = Z.zddCardinality();
+    r.t_cardinality = lap();
+  }
+  catch (const std::exception& e) {
+    r.error = e.what();
+  }
+
+  return r;
+}
+
+// a pzprv3 file of nagare (an error record if its header is not)
+SolveRecord solveFile(const std::string& file, const EdgeOrder order=EdgeOrder::Best, const size_t mem_limit=0)
+{
+  const std::string header = checkNagareHeader(file);
+  if (!header.empty()) {
+    SolveRecord r;
+    r.file = file;
+    r.error = header;
+    return r;
+  }
+  const auto parse = [&file]() { return NagareruProblem(file); };
+  return solveProblem(file, parse, order, mem_limit);
+}
+
+// the k-th record of a corpus, named "file#k+1"
+SolveRecord solveRecord(const NagareruCorpus& corpus, const std::string& file, const size_t k,
+                        const EdgeOrder order=EdgeOrder::Best, const size_t mem_limit=0)
+{
+  const auto parse = [&corpus, k]() { return corpus.getProblem(k); };
+  return solveProblem(file + "#" + std::to_string(k + 1), parse, order, mem_limit);
+}
+
+
+////////////////////////////////////////
+// problem files given by a directory, a glob pattern or a list file
+//   files of a directory or a pattern that do not start with "pzprv3" (e.g. a manifest) are ignored
+//   a list file has a file per line (the 3rd column of a manifest of --rand --count, without skipped instances)
+////////////////////////////////////////
+std::vector<std::string> getBatchFiles(const std::string& path)
+{
+  std::vector<std::string> files;
+
+  // directory or glob pattern
+  struct stat st;
+  const bool is_dir = (stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode));
+  if (is_dir || path.find_first_of("*?[") != std::string::npos) {
+    const std::string pattern = is_dir ? path + "/*.txt" : path;
+    glob_t g;
+    if (glob(pattern.c_str(), 0, NULL, &g) == 0) {
+      for (size_t i = 0; i < g.gl_pathc; ++i) {
+        if (isPzprvFile(g.gl_pathv[i])) files.push_back(g.gl_pathv[i]);
+      }
+    }
+    globfree(&g);
+    return files;
+  }
+
+  // list file
+  std::ifstream ifs(path);
+  if (!ifs) throw std::runtime_error("cannot open " + path);
+  std::string line;
+  while (getline(ifs, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    std::istringstream iss(line);
+    std::vector<std::string> cols;
+    std::string col;
+    while (iss >> col) cols.push_back(col);
+    if (cols.size() >= 3) {
+      if (cols[2] != "skipped") files.push_back(cols[2]);
+    }
+    else if (cols.size() >= 1) files.push_back(cols[0]);
+  }
+  return files;
+}
+
+
+////////////////////////////////////////
+// write records as JSONL or CSV
+////////////////////////////////////////
+std::string quoteJSON(const std::string& s)
+{
+  std::string q = "\"";
+  for (int i = 0; i < s.size(); ++i) {
+    if (s[i] == '"' || s[i] == '\\') q += '\\';
+    q += s[i];
+  }
+  return q + "\"";
+}
+
+std::string quoteCSV(const std::string& s)
+{
+  if (s.find_first_of(",\"\n") == std::string::npos) return s;
+  std::string q = "\"";
+  for (int i = 0; i < s.size(); ++i) {
+    if (s[i] == '"') q += '"';
+    q += s[i];
+  }
+  return q + "\"";
+}
+
+void writeRecordHeader(std::ostream& os, const bool csv)
+{
+  if (!csv) return;
+  os << "file,width,height,nodes,edges,frontier_width,order,zdd_nodes,zdd_nodes_reduced,solutions,"
+     << "t_parse,t_graph,t_frontier,t_construct,t_reduce,t_cardinality,error" << std::endl;
+}
+
+void writeRecord(std::ostream& os, const SolveRecord& r, const bool csv)
+{
+  if (csv) {
+    os << quoteCSV(r.file) << "," << r.W << "," << r.H << "," << r.nodes << "," << r.edges << ","
+       << r.width << "," << r.order << "," << r.zdd_nodes << "," << r.zdd_reduced << "," << r.solutions << ","
+       << r.t_parse << "," << r.t_graph << "," << r.t_frontier << ","
+       << r.t_construct << "," << r.t_reduce << "," << r.t_cardinality << ","
+       << quoteCSV(r.error) << std::endl;
+    return;
+  }
+
+  os << "{\"file\":" << quoteJSON(r.file);
+  if (!r.error.empty()) {
+    os << ",\"error\":" << quoteJSON(r.error) << "}" << std::endl;
+    return;
+  }
+  os << ",\"width\":" << r.W << ",\"height\":" << r.H
+     << ",\"nodes\":" << r.nodes << ",\"edges\":" << r.edges
+     << ",\"frontier_width\":" << r.width << ",\"order\":" << quoteJSON(r.order)
+     << ",\"zdd_nodes\":" << r.zdd_nodes << ",\"zdd_nodes_reduced\":" << r.zdd_reduced
+     << ",\"solutions\":" << quoteJSON(r.solutions)
+     << ",\"time\":{\"parse\":" << r.t_parse << ",\"graph\":" << r.t_graph
+     << ",\"frontier\":" << r.t_frontier << ",\"construct\":" << r.t_construct
+     << ",\"reduce\":" << r.t_reduce << ",\"cardinality\":" << r.t_cardinality << "}}" << std::endl;
+}
+
+
+////////////////////////////////////////
+// solve files on the current # OpenMP threads
+//   a record is written when its file is solved, so the order of records
+//   may differ from files (each record has its file name)
+////////////////////////////////////////
+int solveBatch(const std::vector<std::string>& files, std::ostream& os, const bool csv,
+               const EdgeOrder order=EdgeOrder::Best, const bool use_mp=false, const size_t mem_limit=0)
+{
+  int num_errors = 0;
+  writeRecordHeader(os, csv);
+
+#pragma omp parallel for schedule(dynamic, 1) if(use_mp)
+  for (int i = 0; i < files.size(); ++i) {
+    const SolveRecord r = solveFile(files[i], order, mem_limit);
+#pragma omp critical
+    {
+      writeRecord(os, r, csv);
+      if (!r.error.empty()) num_errors++;
+    }
+  }
+
+  return num_errors;
+}
+
+// the pzprv3 records of a stream named name, read one at a time by each thread
+//   a bad record gives an error record with its byte offset
+int solveBatch(NagareruReader& reader, const std::string& name, std::ostream& os, const bool csv,
+               const EdgeOrder order=EdgeOrder::Best, const bool use_mp=false, const size_t mem_limit=0)
+{
+  int num_errors = 0;
+  writeRecordHeader(os, csv);
+
+#pragma omp parallel if(use_mp)
+  {
+    NagareruReader::Record rec;
+    while (true) {
+      bool found;
+#pragma omp critical(nagareru_reader)
+      found = reader.next(rec);
+      if (!found) break;
+
+      SolveRecord r;
+      const std::string file = name + "#" + std::to_string(rec.index + 1);
+      if (rec.error.empty()) {
+        const auto parse = [&rec]() { return NagareruProblem(rec.W, rec.H, rec.cells); };
+        r = solveProblem(file, parse, order, mem_limit);
+      }
+      else {
+        r.file = file;
+        r.error = "bad record at offset " + std::to_string(rec.offset) + ", " + rec.error;
+      }
+#pragma omp critical
+      {
+        writeRecord(os, r, csv);
+        if (!r.error.empty()) num_errors++;
+      }
+    }
+  }
+
+  return num_errors;
+}
+
+// the records of a corpus mapped from corpus_file
+int solveBatch(const NagareruCorpus& corpus, const std::string& corpus_file, std::ostream& os, const bool csv,
+               const EdgeOrder order=EdgeOrder::Best, const bool use_mp=false, const size_t mem_limit=0)
+{
+  int num_errors = 0;
+  writeRecordHeader(os, csv);
+
+#pragma omp parallel for schedule(dynamic, 1) if(use_mp)
+  for (long k = 0; k < (long)corpus.size(); ++k) {
+    const SolveRecord r = solveRecord(corpus, corpus_file, k, order, mem_limit);
+#pragma omp critical
+    {
+      writeRecord(os, r, csv);
+      if (!r.error.empty()) num_errors++;
+    }
+  }
+
+  return num_errors;
+}
+
+
+////////////////////////////////////////
+// find the problems equal up to rotation and reflection in files, a corpus or a pzprv3 stream
+//   writes "hash name duplicate_of" per problem ("-" for the first one of its canonical hash)
+//   and returns # unique problems
+////////////////////////////////////////
+size_t dedupBatch(const std::string& path, std::ostream& os, int& num_errors)
+{
+  std::unordered_map<uint64_t, std::string> first;
+  const auto add = [&first, &os](const NagareruProblem& P, const std::string& name) {
+    const uint64_t h = P.getCanonicalHash();
+    const auto it = first.insert( std::make_pair(h, name) );
+    std::ostringstream oss;
+    oss << std::hex << std::setw(16) << std::setfill('0') << h;
+    os << oss.str() << " " << name << " " << (it.second ? "-" : it.first->second) << std::endl;
+  };
+
+  num_errors = 0;
+  os << "# hash file duplicate_of" << std::endl;
+  if (path == "-" || isPzprvFile(path)) {
+    std::ifstream ifs;
+    if (path != "-") ifs.open(path);
+    NagareruReader reader((path == "-") ? std::cin : ifs);
+    const std::string name = (path == "-") ? "stdin" : path;
+    NagareruReader::Record rec;
+    while (reader.next(rec)) {
+      const std::string file = name + "#" + std::to_string(rec.index + 1);
+      if (rec.error.empty()) {
+        add(NagareruProblem(rec.W, rec.H, rec.cells), file);
+        continue;
+      }
+      std::cerr << "error : " << file << " : bad record at offset " << rec.offset << ", " << rec.error << std::endl;
+      num_errors++;
+    }
+  }
+  else if (isCorpusFile(path)) {
+    const NagareruCorpus corpus(path);
+    for (size_t k = 0; k < corpus.size(); ++k) {
+      const std::string file = path + "#" + std::to_string(k + 1);
+      try {
+        add(corpus.getProblem(k), file);
+      }
+      catch (const std::exception& e) {
+        std::cerr << "error : " << file << " : " << e.what() << std::endl;
+        num_errors++;
+      }
+    }
+  }
+  else {
+    const std::vector<std::string> files = getBatchFiles(path);
+    for (int i = 0; i < files.size(); ++i) {
+      try {
+        add(NagareruProblem(files[i]), files[i]);
+      }
+      catch (const std::exception& e) {
+        std::cerr << "error : " << e.what() << std::endl;
+        num_errors++;
+      }
+    }
+  }
+
+  return first.size();
+}
+
+
+////////////////////////////////////////
+// convert problem files into a corpus, and a corpus into pzprv3 files DIR/k.txt
+//   return # files that cannot be converted
+////////////////////////////////////////
+int packCorpus(const std::vector<std::string>& files, const std::string& corpus_file)
+{
+  CorpusWriter writer(corpus_file);
+  int num_errors = 0;
+  for (int i = 0; i < files.size(); ++i) {
+    std::string error = checkNagareHeader(files[i]);
+    if (error.empty()) {
+      try {
+        writer.add( NagareruProblem(files[i]) );
+      }
+      catch (const std::exception& e) {
+        error = e.what();
+      }
+    }
+    if (!error.empty()) {
+      std::cerr << "error : " << error << std::endl;
+      num_errors++;
+    }
+  }
+  writer.close();
+  return num_errors;
+}
+
+int unpackCorpus(const std::string& corpus_file, const std::string& dir)
+{
+  const NagareruCorpus corpus(corpus_file);
+  int num_errors = 0;
+  mkdir(dir.c_str(), 0755);
+  for (size_t k = 0; k < corpus.size(); ++k) {
+    try {
+      corpus.getProblem(k).dump(dir + "/" + std::to_string(k + 1) + ".txt");
+    }
+    catch (const std::exception& e) {
+      std::cerr << "error : " << corpus_file << "#" << k + 1 << " : " << e.what() << std::endl;
+      num_errors++;
+    }
+  }
+  return num_errors;
+}
+
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+////////////////////////////////////////
+// include
+////////////////////////////////////////
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "NagareruProblem.hpp"
+
+
+////////////////////////////////////////
+// namespace
+////////////////////////////////////////
+namespace nagareru
+{
+
+////////////////////////////////////////
+// binary corpus of problems (little endian)
+//   header : "NGRC" | version (uint32) | # records (uint64)
+//   index  : offsets of records from the head of the file (uint64 x # records)
+//   record : W (uint16) | H (uint16) | cells (4 bits per cell, row major, low nibble first)
+// a cell is the index of its pzprv3 character in CorpusCellChars
+////////////////////////////////////////
+static const char CorpusMagic[] = "NGRC";
+static const uint32_t CorpusVersion = 1;
+static const char CorpusCellChars[] = ".UDLRNudlrn";
+static const size_t CorpusHeaderSize = 16;
+
+// is file a corpus (i.e. starts with CorpusMagic)
+bool isCorpusFile(const std::string& file)
+{
+  char magic[4] = {0, 0, 0, 0};
+  std::ifstream ifs(file, std::ios::binary);
+  ifs.read(magic, 4);
+  return ifs && memcmp(magic, CorpusMagic, 4) == 0;
+}
+
+
+////////////////////////////////////////
+// Corpus Writer : records are kept in memory and written by close()
+////////////////////////////////////////
+class CorpusWriter
+{
+  std::string file;
+  std::vector<uint64_t> offsets;  // offsets of records from the head of records
+  std::string records;
+
+  static void putInt(std::string& s, const uint64_t v, const int bytes)
+  {
+    for (int b = 0; b < bytes; ++b) s += char((v >> (8 * b)) & 0xff);
+  }
+
+ public:
+
+  CorpusWriter(const std::string& file) : file(file)
+  {
+  }
+
+  size_t size() const
+  {
+    return offsets.size();
+  }
+
+  void add(const NagareruProblem& P)
+  {
+    const int W = P.getW();
+    const int H = P.getH();
+    if (W > 0xffff || H > 0xffff) throw std::runtime_error("too large board for a corpus");
+
+    offsets.push_back(records.size());
+    putInt(records, W, 2);
+    putInt(records, H, 2);
+    std::string cells((W * H + 1) / 2, 0);
+    for (int i = 0; i < W * H; ++i) {
+      const char c = P.getCellChar(i % W + 1, i / W + 1);
+      const int code = strchr(CorpusCellChars, c) - CorpusCellChars;
+      cells[i / 2] |= (i % 2 == 0) ? code : (code << 4);
+    }
+    records += cells;
+  }
+
+  void close()
+  {
+    std::string head(CorpusMagic, 4);
+    putInt(head, CorpusVersion, 4);
+    putInt(head, offsets.size(), 8);
+    const uint64_t base = CorpusHeaderSize + 8 * offsets.size();
+    for (size_t k = 0; k < offsets.size(); ++k) {
+      putInt(head, base + offsets[k], 8);
+    }
+
+    std::ofstream ofs(file, std::ios::binary);
+    ofs.write(head.data(), head.size());
+    ofs.write(records.data(), records.size());
+    if (!ofs) throw std::runtime_error("cannot write " + file);
+  }
+};
+
+
+////////////////////////////////////////
+// Nagareru Corpus : a read-only memory mapping of a corpus file
+//   the header and the index are checked when opened, and a record when read
+////////////////////////////////////////
+class NagareruCorpus
+{
+  const uint8_t* data;  // the mapping
+  size_t bytes;         // # bytes of the mapping
+  size_t num_records;   // # records
+
+  uint64_t getInt(const size_t pos, const int n) const
+  {
+    uint64_t v = 0;
+    for (int b = 0; b < n; ++b) v |= (uint64_t)data[pos + b] << (8 * b);
+    return v;
+  }
+
+  NagareruCorpus(const NagareruCorpus&);
+  NagareruCorpus& operator=(const NagareruCorpus&);
+
+ public:
+
+  NagareruCorpus(const std::string& file) : data(NULL), bytes(0), num_records(0)
+  {
+    const int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("cannot open " + file);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)CorpusHeaderSize) {
+      ::close(fd);
+      throw std::runtime_error("not a corpus file : " + file);
+    }
+    bytes = st.st_size;
+    void* p = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) throw std::runtime_error("cannot map " + file);
+    data = static_cast<const uint8_t*>(p);
+
+    if (memcmp(data, CorpusMagic, 4) != 0 || getInt(4, 4) != CorpusVersion) {
+      munmap(p, bytes);
+      throw std::runtime_error("not a corpus file (or another version) : " + file);
+    }
+    num_records = getInt(8, 8);
+    if (num_records > (bytes - CorpusHeaderSize) / 8) {
+      munmap(p, bytes);
+      throw std::runtime_error("truncated corpus index : " + file);
+    }
+  }
+
+  ~NagareruCorpus()
+  {
+    munmap(const_cast<uint8_t*>(data), bytes);
+  }
+
+  size_t size() const
+  {
+    return num_records;
+  }
+
+  // W * H characters of pzprv3 of the k-th record
+  std::string getCells(const size_t k, int& W, int& H) const
+  {
+    if (k >= num_records) throw std::out_of_range("no record " + std::to_string(k));
+    const uint64_t pos = getInt(CorpusHeaderSize + 8 * k, 8);
+    if (pos + 4 > bytes) throw std::runtime_error("truncated record " + std::to_string(k));
+    W = getInt(pos, 2);
+    H = getInt(pos + 2, 2);
+    const size_t n = (size_t)W * H;
+    if (pos + 4 + (n + 1) / 2 > bytes) throw std::runtime_error("truncated record " + std::to_string(k));
+
+    std::string cells(n, '.');
+    const uint8_t* p = data + pos + 4;
+    for (size_t i = 0; i < n; ++i) {
+      const int code = (i % 2 == 0) ? (p[i / 2] & 0xf) : (p[i / 2] >> 4);
+      if (code >= (int)sizeof(CorpusCellChars) - 1) {
+        throw std::runtime_error("invalid cell code in record " + std::to_string(k));
+      }
+      cells[i] = CorpusCellChars[code];
+    }
+    return cells;
+  }
+
+  NagareruProblem getProblem(const size_t k) const
+  {
+    int W, H;
+    const std::string cells = getCells(k, W, H);
+    return NagareruProblem(W, H, cells);
+  }
+};
+
+}
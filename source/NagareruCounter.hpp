@@ -0,0 +1,239 @@
+#pragma once
+
+////////////////////////////////////////
+// include
+////////////////////////////////////////
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "NagareruSpec.hpp"
+
+
+////////////////////////////////////////
+// namespace
+////////////////////////////////////////
+namespace nagareru
+{
+
+
+////////////////////////////////////////
+// Nagareru Counter : count solutions of NagareruSpec without DdStructure
+////////////////////////////////////////
+class NagareruCounter
+{
+  ////////////////////////////////////////
+  // non-negative integer in base 10^9
+  ////////////////////////////////////////
+ public:
+
+  struct BigCount {
+    std::vector<uint32_t> d; // little endian
+
+    void add(const BigCount& b)
+    {
+      if (d.size() < b.d.size()) d.resize(b.d.size(), 0);
+      uint32_t carry = 0;
+      for (int i = 0; i < d.size(); ++i) {
+        uint32_t x = d[i] + carry + (i < b.d.size() ? b.d[i] : 0);
+        carry = (x >= 1000000000u) ? 1 : 0;
+        d[i] = x - carry * 1000000000u;
+      }
+      if (carry) d.push_back(carry);
+    }
+
+    std::string str() const
+    {
+      if (d.empty()) return "0";
+      std::string s = std::to_string(d.back());
+      for (int i = (int)d.size() - 2; i >= 0; --i) {
+        const std::string t = std::to_string(d[i]);
+        s += std::string(9 - t.size(), '0') + t;
+      }
+      return s;
+    }
+  };
+
+
+  ////////////////////////////////////////
+  // class members
+  ////////////////////////////////////////
+ private:
+
+  const NagareruSpec& spec;
+  const int S; // # elements of a state
+
+  // state buffers of levels
+  std::vector<NagareruState> cur;
+  std::vector<NagareruState> tmp;
+
+  // memo[level] : state -> # solutions (saturated)
+  std::vector<std::unordered_map<std::string, int> > memo;
+
+  // max # states of a level in count()
+  size_t max_states;
+
+
+  ////////////////////////////////////////
+  // constructor
+  ////////////////////////////////////////
+ public:
+
+  NagareruCounter(const NagareruSpec& spec) : spec(spec), S(spec.getStateSize()), max_states(0)
+  {
+  }
+
+  size_t getMaxStates(void) const
+  {
+    return max_states;
+  }
+
+
+  ////////////////////////////////////////
+  // # solutions : breadth first, level by level
+  //   a level is dropped as soon as its children are created, so the
+  //   memory is proportional to the widest level, not to the whole ZDD
+  ////////////////////////////////////////
+ public:
+
+  std::string count(void)
+  {
+    const int m = spec.getFrontierManager().getEdgeSize();
+    const size_t bytes = S * sizeof(NagareruState);
+    std::vector<NagareruState> s(S + 1, NagareruState());
+    BigCount one;
+    one.d.push_back(1);
+    BigCount total;
+    max_states = 0;
+
+    // states[level] : state -> # paths from the root
+    std::vector<std::unordered_map<std::string, BigCount> > states(m + 1);
+
+    const int root = spec.getRoot(&s[0]);
+    if (root == 0) return "0";
+    if (root < 0) return "1";
+    states[root][std::string(reinterpret_cast<const char*>(&s[0]), bytes)] = one;
+
+    for (int level = root; level > 0; --level) {
+      std::unordered_map<std::string, BigCount> cur;
+      cur.swap(states[level]);
+      if (max_states < cur.size()) max_states = cur.size();
+
+      for (auto itr = cur.begin(); itr != cur.end(); ++itr) {
+        for (int b = 0; b < 2; ++b) {
+          std::memcpy(&s[0], itr->first.data(), bytes);
+          const int c = spec.getChild(&s[0], level, b);
+          if (c < 0) {
+            total.add(itr->second);
+          }
+          else if (c > 0) {
+            states[c][std::string(reinterpret_cast<const char*>(&s[0]), bytes)].add(itr->second);
+          }
+        }
+      }
+    }
+
+    return total.str();
+  }
+
+
+  ////////////////////////////////////////
+  // # solutions saturated at limit : min(# solutions, limit)
+  //   depth first, stops as soon as limit solutions are found
+  ////////////////////////////////////////
+ public:
+
+  int countUpTo(const int limit, std::vector<std::set<int> >* sols=NULL)
+  {
+    const int m = spec.getFrontierManager().getEdgeSize();
+    cur.assign((m + 1) * S, NagareruState());
+    tmp.assign((m + 1) * S, NagareruState());
+    memo.assign(m + 1, std::unordered_map<std::string, int>());
+
+    const int root = spec.getRoot(&cur[m * S]);
+    if (root == 0) return 0;
+    if (root < 0) return 1;
+    copy(&cur[root * S], &cur[m * S]);
+
+    const int cnt = countUpTo(root, limit);
+
+    // up to limit solutions as sets of levels
+    if (sols != NULL) {
+      sols->clear();
+      std::vector<int> path;
+      getSolutions(root, limit, path, *sols);
+    }
+
+    memo.clear();
+    return cnt;
+  }
+
+
+  ////////////////////////////////////////
+  // private
+  ////////////////////////////////////////
+ private:
+
+  void copy(NagareruState* to, const NagareruState* from) const
+  {
+    if (to != from) std::memcpy(to, from, S * sizeof(NagareruState));
+  }
+
+  // the state of level is cur[level]
+  //   memo keeps min(# solutions, limit), so limit must be the same in a run
+  int countUpTo(const int level, const int limit)
+  {
+    const NagareruState* s = &cur[level * S];
+    const std::string key(reinterpret_cast<const char*>(s), S * sizeof(NagareruState));
+    const auto itr = memo[level].find(key);
+    if (itr != memo[level].end()) {
+      return itr->second;
+    }
+
+    int cnt = 0;
+    for (int b = 1; b >= 0 && cnt < limit; --b) {
+      NagareruState* t = &tmp[level * S];
+      copy(t, s);
+      const int c = spec.getChild(t, level, b);
+      if (c < 0) {
+        cnt++;
+      }
+      else if (c > 0) {
+        copy(&cur[c * S], t);
+        cnt += countUpTo(c, limit);
+      }
+    }
+    if (cnt > limit) cnt = limit;
+
+    memo[level][key] = cnt;
+    return cnt;
+  }
+
+  // follow the states with positive counts in memo
+  void getSolutions(const int level, const int limit, std::vector<int>& path, std::vector<std::set<int> >& sols)
+  {
+    for (int b = 1; b >= 0 && sols.size() < limit; --b) {
+      NagareruState* t = &tmp[level * S];
+      copy(t, &cur[level * S]);
+      const int c = spec.getChild(t, level, b);
+      if (b) path.push_back(level);
+      if (c < 0) {
+        sols.push_back( std::set<int>(path.begin(), path.end()) );
+      }
+      else if (c > 0) {
+        const std::string key(reinterpret_cast<const char*>(t), S * sizeof(NagareruState));
+        const auto itr = memo[c].find(key);
+        if (itr != memo[c].end() && itr->second > 0) {
+          copy(&cur[c * S], t);
+          getSolutions(c, limit, path, sols);
+        }
+      }
+      if (b) path.pop_back();
+    }
+  }
+};
+
+}
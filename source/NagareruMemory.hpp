@@ -0,0 +1,112 @@
+#pragma once
+
+////////////////////////////////////////
+// include
+////////////////////////////////////////
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <sys/resource.h>
+
+
+////////////////////////////////////////
+// namespace
+////////////////////////////////////////
+namespace nagareru
+{
+
+////////////////////////////////////////
+// exit code of a run stopped by --mem-limit
+////////////////////////////////////////
+static const int EXIT_MEMORY_LIMIT = 3;
+
+////////////////////////////////////////
+// memory of the process
+////////////////////////////////////////
+// peak resident set size in bytes
+size_t getPeakRSS(void)
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return (size_t)ru.ru_maxrss * 1024;
+}
+
+// "512M", "2G", "1048576" -> bytes
+size_t parseBytes(const std::string& s)
+{
+  size_t pos = 0;
+  const double x = std::stod(s, &pos);
+  double k = 1;
+  if (pos < s.size()) {
+    switch (s[pos]) {
+      case 'k': case 'K': k = 1024.0; break;
+      case 'm': case 'M': k = 1024.0 * 1024; break;
+      case 'g': case 'G': k = 1024.0 * 1024 * 1024; break;
+      default: throw std::invalid_argument("invalid size : " + s);
+    }
+  }
+  return (size_t)(x * k);
+}
+
+////////////////////////////////////////
+// thrown when a problem cannot be checked within the budget
+////////////////////////////////////////
+struct MemoryLimitExceeded : public std::runtime_error {
+  MemoryLimitExceeded() : std::runtime_error("memory limit exceeded") {}
+};
+
+////////////////////////////////////////
+// Memory Budget : the memory limit of a construction
+//   the construction charges the bytes of each child it creates (see NagareruSpec),
+//   so the limit is per construction and does not depend on the RSS of other threads;
+//   charge() keeps returning false once the charged bytes exceed the limit
+////////////////////////////////////////
+class MemoryBudget
+{
+  const size_t limit;              // bytes (0 = unlimited)
+  std::atomic<size_t> used;        // bytes charged so far
+  std::atomic<bool> exceeded;
+  std::atomic<int> exceeded_level; // the level at which the limit is exceeded
+
+ public:
+
+  // bytes of a node of a binary ZDD (two 64-bit children)
+  static const size_t NODE_BYTES = 2 * sizeof(uint64_t);
+
+  MemoryBudget(const size_t limit=0)
+      : limit(limit), used(0), exceeded(false), exceeded_level(0)
+  {
+  }
+
+  bool charge(const int level, const size_t bytes)
+  {
+    if (exceeded.load(std::memory_order_relaxed)) return false;
+    if (used.fetch_add(bytes, std::memory_order_relaxed) + bytes <= limit) return true;
+    exceeded_level = level;
+    exceeded = true;
+    return false;
+  }
+
+  size_t getLimit() const
+  {
+    return limit;
+  }
+
+  size_t getUsed() const
+  {
+    return used;
+  }
+
+  bool isExceeded() const
+  {
+    return exceeded;
+  }
+
+  int getExceededLevel() const
+  {
+    return exceeded_level;
+  }
+};
+
+}
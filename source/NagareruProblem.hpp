@@ -6,12 +6,17 @@
 // standard libraries
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <cstdint>
 
 // tdzdd
 #include <tdzdd/DdSpec.hpp>
 #include <tdzdd/DdStructure.hpp>
 #include <tdzdd/util/Graph.hpp>
 
+// self
+#include "NagareruReader.hpp"
+
 
 ////////////////////////////////////////
 // namespace
@@ -96,12 +101,17 @@ class NagareruProblem
   int H;  // height
 
   int num_white_cells; // # white celss
+  int num_black_cells; // # black cells
+  int num_unions;      // # edges joining two components of UF
   int num_white_edges; // # white edges
   int last_white_edge; // the index of the last white edge
 
   std::vector< Color > C;                    // colors of cells
   std::vector< std::vector< Direction > > D; // direction sets of cells
   std::vector< Edge > E;                     // edge list
+  std::vector< int > NB[4];                  // nearest black cells toward Up, Down, Left & Right
+  std::vector< int > UF;                     // union-find parents of cells over E
+  std::vector< int > US;                     // union-find sizes of roots
 
   ////////////////////////////////////////
   // private set/add
@@ -150,6 +160,159 @@ class NagareruProblem
     }
   }
 
+  ////////////////////////////////////////
+  // for properize(x, y)
+  ////////////////////////////////////////
+  bool hasDirection(const int i, const Direction d) const
+  {
+    return std::find(D[i].begin(), D[i].end(), d) != D[i].end();
+  }
+
+  // set the winds of a non white/black cell i from the left, above, below
+  // and right in the order of properize(), and return true if i is changed
+  bool setWinds(const int i, const bool l, const bool u, const bool d, const bool r)
+  {
+    std::vector<Direction> winds;
+    if (l) winds.push_back(Direction::Right);
+    if (u) winds.push_back(Direction::Down);
+    if (d) winds.push_back(Direction::Up);
+    if (r) winds.push_back(Direction::Left);
+
+    const Color col = winds.empty() ? Color::No : Color::Gray;
+    if (C[i] == col && D[i] == winds) return false;
+    C[i] = col;
+    D[i].swap(winds);
+    return true;
+  }
+
+  void addEdge(std::vector<Edge>& F, const int i, const int j)
+  {
+    if (C[i] == Color::White || C[j] == Color::White) {
+      num_white_edges++;
+      last_white_edge = F.size();
+    }
+    F.push_back( Edge(i, j) );
+  }
+
+  ////////////////////////////////////////
+  // nearest black cells
+  ////////////////////////////////////////
+  // (re)compute NB from scratch
+  void initNearestBlack(void)
+  {
+    for (int d = 0; d < 4; ++d) {
+      NB[d].assign(W * H, -1);
+    }
+    for (int x = 1; x <= W; ++x) {
+      for (int y = 2; y <= H; ++y) {
+        const int j = getPos(x, y-1);
+        NB[0][ getPos(x,y) ] = (C[j] == Color::Black) ? j : NB[0][j];
+      }
+      for (int y = H-1; y > 0; --y) {
+        const int j = getPos(x, y+1);
+        NB[1][ getPos(x,y) ] = (C[j] == Color::Black) ? j : NB[1][j];
+      }
+    }
+    for (int y = 1; y <= H; ++y) {
+      for (int x = 2; x <= W; ++x) {
+        const int j = getPos(x-1, y);
+        NB[2][ getPos(x,y) ] = (C[j] == Color::Black) ? j : NB[2][j];
+      }
+      for (int x = W-1; x > 0; --x) {
+        const int j = getPos(x+1, y);
+        NB[3][ getPos(x,y) ] = (C[j] == Color::Black) ? j : NB[3][j];
+      }
+    }
+  }
+
+  // (x, y) has been changed into / from black : update its row & column
+  // up to (and including) the next black cell on each side
+  void updateNearestBlack(const int x, const int y)
+  {
+    const int i = getPos(x, y);
+    const bool black = (C[i] == Color::Black);
+
+    for (int z = y - 1; z > 0; --z) {
+      const int j = getPos(x, z);
+      NB[1][j] = black ? i : NB[1][i];
+      if (C[j] == Color::Black) break;
+    }
+    for (int z = y + 1; z <= H; ++z) {
+      const int j = getPos(x, z);
+      NB[0][j] = black ? i : NB[0][i];
+      if (C[j] == Color::Black) break;
+    }
+    for (int z = x - 1; z > 0; --z) {
+      const int j = getPos(z, y);
+      NB[3][j] = black ? i : NB[3][i];
+      if (C[j] == Color::Black) break;
+    }
+    for (int z = x + 1; z <= W; ++z) {
+      const int j = getPos(z, y);
+      NB[2][j] = black ? i : NB[2][i];
+      if (C[j] == Color::Black) break;
+    }
+  }
+
+  ////////////////////////////////////////
+  // union-find over E
+  //   black cells are always singletons, so # components of the non-black
+  //   cells is (# non-black cells) - num_unions
+  ////////////////////////////////////////
+  int findRoot(int i) const
+  {
+    while (UF[i] != i) i = UF[i];
+    return i;
+  }
+
+  void unite(const int i, const int j)
+  {
+    int ri = findRoot(i);
+    int rj = findRoot(j);
+    if (ri == rj) return;
+    if (US[ri] < US[rj]) std::swap(ri, rj);
+    UF[rj] = ri;
+    US[ri] += US[rj];
+    num_unions++;
+  }
+
+  // (re)compute UF from scratch
+  void initComponents(void)
+  {
+    UF.resize(W * H);
+    US.assign(W * H, 1);
+    for (int i = 0; i < W * H; ++i) {
+      UF[i] = i;
+    }
+    num_unions = 0;
+    for (int i = 0; i < E.size(); ++i) {
+      unite(E[i].v1, E[i].v2);
+    }
+  }
+
+  // initialize the board by W * H characters of pzprv3
+  void init(const std::string& cells)
+  {
+    std::vector<Cell> cs;
+    for (int y = 1; y <= H; ++y) {
+      for (int x = 1; x <= W; ++x) {
+        const char c = cells[ getPos(x,y) ];
+        if (c == '.') continue;
+        const char col = (std::isupper(c)) ? 'B' : 'W';
+        const char dir = ('a' <= c && c <= 'z') ? c-32 : c;
+        cs.push_back( Cell(x, y, col, dir) );
+      }
+    }
+
+    C.resize(W * H);
+    D.resize(W * H);
+    for (int i = 0; i < W * H; ++i) {
+      C[i] = Color::No;
+    }
+    setCells(cs);
+    properize();
+  }
+
   ////////////////////////////////////////////////////////////////////////////////
   // public
   ////////////////////////////////////////////////////////////////////////////////
@@ -167,9 +330,15 @@ class NagareruProblem
 
     // set
     const int i = getPos(x, y);
+    const bool black = (C[i] == Color::Black);
+    if (C[i] == Color::White) num_white_cells--;
+    if (col == Color::White) num_white_cells++;
+    if (black) num_black_cells--;
+    if (col == Color::Black) num_black_cells++;
     C[i] = col;
     D[i].clear();
     D[i].push_back(dir);
+    if (black != (col == Color::Black)) updateNearestBlack(x, y);
   }
 
   void resetCell(const int x, const int y)
@@ -179,8 +348,12 @@ class NagareruProblem
     assert(1 <= y && y <= H);
 
     // reset
+    const bool black = (C[ getPos(x,y) ] == Color::Black);
+    if (C[ getPos(x,y) ] == Color::White) num_white_cells--;
+    if (black) num_black_cells--;
     C[ getPos(x,y) ] = Color::No;
     D[ getPos(x,y) ].clear();
+    if (black) updateNearestBlack(x, y);
   }
 
   ////////////////////////////////////////
@@ -211,6 +384,32 @@ class NagareruProblem
     return last_white_edge;
   }
 
+  // # connected components of the non-black cells over E
+  const int getNumComponents() const
+  {
+    return W * H - num_black_cells - num_unions;
+  }
+
+  // comp[i] : the component of cell i in [0, # components) (-1 for black)
+  const int getComponents(std::vector<int>& comp) const
+  {
+    std::vector<int> label(W * H, -1);
+    int n = 0;
+    comp.assign(W * H, -1);
+    for (int i = 0; i < W * H; ++i) {
+      if (C[i] == Color::Black) continue;
+      const int r = findRoot(i);
+      if (label[r] < 0) label[r] = n++;
+      comp[i] = label[r];
+    }
+    return n;
+  }
+
+  const std::pair<int, int> getEdge(const int i) const
+  {
+    return std::make_pair(E[i].v1, E[i].v2);
+  }
+
   const int getPos(const int x, const int y) const
   {
     return W * (y-1) + (x-1);
@@ -236,6 +435,98 @@ class NagareruProblem
     return D[ getPos(x,y) ];
   }
 
+  // the character of (x, y) in pzprv3 : 'U' etc. for black, 'u' etc. for white and '.' otherwise
+  char getCellChar(const int x, const int y) const
+  {
+    return getCellChar(0, x, y);
+  }
+
+  ////////////////////////////////////////
+  // symmetries : the dihedral group of 8 rotations and reflections
+  //   the board of a symmetry t (0-7) flips the x axis if t & 1, the y axis if t & 2
+  //   and then transposes the board if t & 4 (arrows are turned with the cells)
+  ////////////////////////////////////////
+  const int getW(const int t) const
+  {
+    return (t & 4) ? H : W;
+  }
+
+  const int getH(const int t) const
+  {
+    return (t & 4) ? W : H;
+  }
+
+  // the character of (x, y) of the board of t
+  char getCellChar(const int t, const int x, const int y) const
+  {
+    // (x, y) -> the original cell
+    int sx = (t & 4) ? y : x;
+    int sy = (t & 4) ? x : y;
+    if (t & 1) sx = W + 1 - sx;
+    if (t & 2) sy = H + 1 - sy;
+    const int i = getPos(sx, sy);
+    if (C[i] != Color::White && C[i] != Color::Black) return '.';
+
+    // Up, Down, Left, Right = 0, 1, 2, 3
+    int d = D[i].empty() ? static_cast<int>(Direction::No) : static_cast<int>(D[i][0]);
+    if ((t & 1) && (d == 2 || d == 3)) d ^= 1;  // Left <-> Right
+    if ((t & 2) && (d == 0 || d == 1)) d ^= 1;  // Up <-> Down
+    if ((t & 4) && d < 4)              d ^= 2;  // Up <-> Left, Down <-> Right
+    const char c = DirectionNames[d][0];
+    return (C[i] == Color::White) ? char(c + 32) : c;
+  }
+
+  // FNV-1a hash of W, H and the characters of the cells in pzprv3 (of the board of t)
+  uint64_t getHash(const int t=0) const
+  {
+    uint64_t h = 14695981039346656037ULL;
+    const auto add = [&h](const uint64_t v) {
+      h ^= v;
+      h *= 1099511628211ULL;
+    };
+    add( getW(t) );
+    add( getH(t) );
+    for (int y = 1; y <= getH(t); ++y) {
+      for (int x = 1; x <= getW(t); ++x) {
+        add( getCellChar(t, x, y) );
+      }
+    }
+    return h;
+  }
+
+  // the symmetry of the smallest board : the narrower one first, and then the
+  // smaller characters in row major order (all boards are scanned at once)
+  int getCanonicalSymmetry() const
+  {
+    int S[8];
+    int n = 0;
+    for (int t = 0; t < 8; ++t) {
+      if (getW(t) == std::min(W, H)) S[n++] = t;
+    }
+
+    const int w = getW(S[0]);
+    for (int p = 0; p < W * H && n > 1; ++p) {
+      char c[8];
+      char c_min = c[0] = getCellChar(S[0], p % w + 1, p / w + 1);
+      for (int k = 1; k < n; ++k) {
+        c[k] = getCellChar(S[k], p % w + 1, p / w + 1);
+        c_min = std::min(c_min, c[k]);
+      }
+      int m = 0;
+      for (int k = 0; k < n; ++k) {
+        if (c[k] == c_min) S[m++] = S[k];
+      }
+      n = m;
+    }
+    return S[0];
+  }
+
+  // the same hash for the 8 rotations and reflections of a board, e.g. as a cache key
+  uint64_t getCanonicalHash() const
+  {
+    return getHash( getCanonicalSymmetry() );
+  }
+
   Direction getRelativeDirection(const int i, const int j) const
   {
     if(i+1 == j) return Direction::Right;
@@ -248,50 +539,33 @@ class NagareruProblem
   std::vector<Direction> getWinds(const int x, const int y) const
   {
     std::vector<Direction> winds;
+    const int i = getPos(x, y);
 
     // check Up
-    for (int z = y + 1; z <= H; ++z) {
-      if (getColor(x,z) == Color::Black) {
-        if (getDirection(x,z)[0] == Direction::Up) {
-          winds.push_back(Direction::Up);
-        }
-        break;
-      }
-    }
+    int j = getNearestBlack(i, Direction::Down);
+    if (j >= 0 && D[j][0] == Direction::Up) winds.push_back(Direction::Up);
 
     // chek Down
-    for (int z = y - 1; z > 0; --z) {
-      if (getColor(x,z) == Color::Black) {
-        if (getDirection(x,z)[0] == Direction::Down){
-          winds.push_back(Direction::Down);
-        }
-        break;
-      }
-    }
+    j = getNearestBlack(i, Direction::Up);
+    if (j >= 0 && D[j][0] == Direction::Down) winds.push_back(Direction::Down);
 
     // check Left
-    for (int z = x + 1; z <= W; ++z) {
-      if (getColor(z,y) == Color::Black) {
-        if (getDirection(z,y)[0] == Direction::Left) {
-          winds.push_back(Direction::Left);
-        }
-        break;
-      }
-    }
+    j = getNearestBlack(i, Direction::Right);
+    if (j >= 0 && D[j][0] == Direction::Left) winds.push_back(Direction::Left);
 
     // check Right
-    for (int z = x - 1; z > 0; --z) {
-      if (getColor(z,y) == Color::Black) {
-        if (getDirection(z,y)[0] == Direction::Right) {
-          winds.push_back(Direction::Right);
-        }
-        break;
-      }
-    }
+    j = getNearestBlack(i, Direction::Left);
+    if (j >= 0 && D[j][0] == Direction::Right) winds.push_back(Direction::Right);
 
     return winds;
   }
 
+  // the nearest black cell from i toward d (-1 if none)
+  const int getNearestBlack(const int i, const Direction d) const
+  {
+    return NB[ static_cast<int>(d) ][i];
+  }
+
   ////////////////////////////////////////
   // is
   ////////////////////////////////////////
@@ -493,41 +767,90 @@ class NagareruProblem
     return true;
   }
 
-  bool isConnected(void) const
+  ////////////////////////////////////////
+  // is S a solution : S is a set of edges (pairs of cells)
+  ////////////////////////////////////////
+  bool isSolution(const std::vector< std::pair<int, int> >& S) const
   {
-    // require proparized
+    if (S.empty()) return false;
+
+    // adjacency
+    std::vector< std::vector<int> > adj(W * H);
+    for (int i = 0; i < S.size(); ++i) {
+      const int a = S[i].first;
+      const int b = S[i].second;
+      if (!isValidEdge(a, b)) return false;
+      adj[a].push_back(b);
+      adj[b].push_back(a);
+    }
 
-    // flag of visit
-    std::vector<bool> visited;
-    for (int i = 0; i < W*H; ++i) {
-      visited.push_back(false);
+    // degree 0 or 2 and all white cells are used
+    for (int i = 0; i < W * H; ++i) {
+      if (adj[i].size() != 0 && adj[i].size() != 2) return false;
+      if (C[i] == Color::White && adj[i].empty()) return false;
     }
 
-    // search
-    const int r = E[0].v1;
-    visited[r] = true;
-    for (int i = 0; i < E.size(); ++i) {
-      const Edge e = E[i];
-      if (visited[e.v1]) {
-        visited[e.v2] = true;
-      }
+    // a single cycle
+    std::vector<int> cycle(1, S[0].first);
+    int prev = S[0].first;
+    int cur  = S[0].second;
+    while (cur != S[0].first) {
+      cycle.push_back(cur);
+      const int next = (adj[cur][0] == prev) ? adj[cur][1] : adj[cur][0];
+      prev = cur;
+      cur  = next;
     }
+    if (cycle.size() != S.size()) return false;
+
+    // flows in either direction
+    if (isValidFlow(cycle)) return true;
+    std::reverse(cycle.begin(), cycle.end());
+    return isValidFlow(cycle);
+  }
+
+  // cycle[0] -> cycle[1] -> ... -> cycle[0]
+  bool isValidFlow(const std::vector<int>& cycle) const
+  {
+    const int n = cycle.size();
+    for (int k = 0; k < n; ++k) {
+      const int a = cycle[k];
+      const int b = cycle[(k + 1) % n];
+      const int c = cycle[(k + 2) % n];
+      const Direction f = getRelativeDirection(a, b);
+      const Direction g = getRelativeDirection(b, c);
+
+      // a -> b against a direction of a or b
+      for (int l = 0; l < D[a].size(); ++l) {
+        if (D[a][l] == getOppositeDirection(f)) return false;
+      }
+      for (int l = 0; l < D[b].size(); ++l) {
+        if (D[b][l] == getOppositeDirection(f)) return false;
+      }
 
-    // check
-    for (int i = 0; i < W*H; ++i) {
-      if (C[i] != Color::Black && !visited[i]) {
-        return false;
+      // go straight across a wind of b
+      if (C[b] == Color::Gray && f == g) {
+        for (int l = 0; l < D[b].size(); ++l) {
+          if (D[b][l] != f && D[b][l] != getOppositeDirection(f)) return false;
+        }
       }
     }
-
     return true;
   }
 
+  bool isConnected(void) const
+  {
+    // require proparized
+    return getNumComponents() <= 1;
+  }
+
   ////////////////////////////////////////
   // properize
   ////////////////////////////////////////
   bool properize(void)
   {
+    // (re)compute nearest black cells
+    initNearestBlack();
+
     // reset current Gray cells
     for (int x = 1; x <= W; ++x) {
       for (int y = 1; y <= H ; ++y) {
@@ -589,14 +912,21 @@ class NagareruProblem
       if (isValidEdge(i, i+W)) E.push_back( Edge(i, i+W) );
     }
 
-    // (re)count white cells
+    // (re)count white & black cells
     num_white_cells = 0;
+    num_black_cells = 0;
     for (int i = 0; i< W * H; ++i) {
       if (C[i] == Color::White) {
         num_white_cells++;
       }
+      if (C[i] == Color::Black) {
+        num_black_cells++;
+      }
     }
 
+    // (re)compute components
+    initComponents();
+
     // (re)count white edges
     num_white_edges = 0;
     last_white_edge = 0;
@@ -611,71 +941,178 @@ class NagareruProblem
   }
 
   ////////////////////////////////////////
-  // const from pzprv3 file
+  // properize after setCell / resetCell of (x, y) on a properized board
+  //   only the winds along row y and column x can change, and so do the
+  //   edges around the changed cells
   ////////////////////////////////////////
-  NagareruProblem(const std::string file)
-      : W(0), H(0), num_white_cells(0), num_white_edges(0)
+  bool properize(const int x, const int y)
   {
-    // open file
-    std::ifstream ifs(file, std::ios::in);
-    if (!ifs) throw std::runtime_error(strerror(errno));
-
-    std::string line;
-
-    // line 1 : format
-    getline(ifs, line);
-    assert(line == "pzprv3");
+#ifdef NAGARERU_DEBUG
+    NagareruProblem Q = *this;
+    Q.properize();
+#endif
+
+    // winds from the left / right along row y
+    std::vector<bool> wl(W + 2, false), wr(W + 2, false);
+    for (int z = 1; z <= W; ++z) {
+      const int i = getPos(z, y);
+      if (C[i] == Color::Black) wl[z+1] = (D[i][0] == Direction::Right);
+      else wl[z+1] = wl[z];
+    }
+    for (int z = W; z > 0; --z) {
+      const int i = getPos(z, y);
+      if (C[i] == Color::Black) wr[z-1] = (D[i][0] == Direction::Left);
+      else wr[z-1] = wr[z];
+    }
 
-    // line 2 : puzzle name
-    getline(ifs, line);
-    assert(line == "nagare");
+    // winds from above / below along column x
+    std::vector<bool> wu(H + 2, false), wd(H + 2, false);
+    for (int z = 1; z <= H; ++z) {
+      const int i = getPos(x, z);
+      if (C[i] == Color::Black) wu[z+1] = (D[i][0] == Direction::Down);
+      else wu[z+1] = wu[z];
+    }
+    for (int z = H; z > 0; --z) {
+      const int i = getPos(x, z);
+      if (C[i] == Color::Black) wd[z-1] = (D[i][0] == Direction::Up);
+      else wd[z-1] = wd[z];
+    }
 
-    // line 3 : H
-    getline(ifs, line);
-    H = std::stoi(line);
+    // (re)compute Gray cells on row y & column x
+    //   the winds across the line are kept from the current directions
+    std::vector<int> changed(1, getPos(x, y));
+    for (int z = 1; z <= W; ++z) {
+      const int i = getPos(z, y);
+      if (C[i] == Color::White || C[i] == Color::Black) continue;
+      const bool u = (z == x) ? wu[y] : hasDirection(i, Direction::Down);
+      const bool d = (z == x) ? wd[y] : hasDirection(i, Direction::Up);
+      if (setWinds(i, wl[z], u, d, wr[z]) && z != x) changed.push_back(i);
+    }
+    for (int z = 1; z <= H; ++z) {
+      const int i = getPos(x, z);
+      if (z == y || C[i] == Color::White || C[i] == Color::Black) continue;
+      const bool l = hasDirection(i, Direction::Right);
+      const bool r = hasDirection(i, Direction::Left);
+      if (setWinds(i, l, wu[z], wd[z], r)) changed.push_back(i);
+    }
 
-    // line 4 : W
-    getline(ifs, line);
-    W = std::stoi(line);
+    // edges around the changed cells : 2i for (i, i+1), 2i+1 for (i, i+W)
+    std::vector<int> keys;
+    for (int k = 0; k < changed.size(); ++k) {
+      const int i = changed[k];
+      keys.push_back(2 * i);
+      keys.push_back(2 * i + 1);
+      if (i % W != 0) keys.push_back(2 * (i - 1));
+      if (i >= W)     keys.push_back(2 * (i - W) + 1);
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    // patch edge list E & (re)count white edges
+    std::vector<Edge> F;
+    F.reserve(E.size() + keys.size());
+    std::vector<int> added;
+    bool removed = false;
+    num_white_edges = 0;
+    last_white_edge = 0;
+    int k = 0;
+    for (int l = 0; l <= E.size(); ++l) {
+      const int key = (l < E.size()) ? 2 * E[l].v1 + (E[l].v2 - E[l].v1 == W ? 1 : 0) : 2 * W * H;
+      for (; k < keys.size() && keys[k] <= key; ++k) {
+        const int i = keys[k] / 2;
+        const int j = (keys[k] % 2 == 0) ? i + 1 : i + W;
+        const bool old = (keys[k] == key);
+        if (isValidEdge(i, j)) {
+          addEdge(F, i, j);
+          if (!old) added.push_back(F.size() - 1);
+        }
+        else if (old) {
+          removed = true;
+        }
+      }
+      if (l == E.size() || (k > 0 && keys[k-1] == key)) continue;
+      addEdge(F, E[l].v1, E[l].v2);
+    }
+    E.swap(F);
 
-    // lint 5-5+H : row
-    std::vector<Cell> cells;
-    for (int y = 1; y <= H; ++y) {
-      getline(ifs, line);
-      for (int x = 1; x <= W; ++x) {
-        const char c = line[2*(x-1)];
-        if (c == '.') continue;
-        const char col = (std::isupper(c)) ? 'B' : 'W';
-        const char dir = ('a' <= c && c <= 'z') ? c-32 : c;
-        Cell cell(x, y, col, dir);
-        cells.push_back(cell);
+    // update components : new edges are just united, while a removed edge
+    // may split a component
+    if (removed) {
+      initComponents();
+    }
+    else {
+      for (int l = 0; l < added.size(); ++l) {
+        unite(E[ added[l] ].v1, E[ added[l] ].v2);
       }
     }
 
+#ifdef NAGARERU_DEBUG
+    bool same = (C == Q.C && D == Q.D && E.size() == Q.E.size());
+    for (int i = 0; same && i < E.size(); ++i) {
+      same = (E[i].v1 == Q.E[i].v1 && E[i].v2 == Q.E[i].v2);
+    }
+    same = same && num_white_cells == Q.num_white_cells;
+    same = same && num_white_edges == Q.num_white_edges;
+    same = same && last_white_edge == Q.last_white_edge;
+    same = same && getNumComponents() == Q.getNumComponents();
+    for (int d = 0; d < 4; ++d) {
+      same = same && NB[d] == Q.NB[d];
+    }
+    if (!same) {
+      std::cerr << "properize : mismatch at (" << x << ", " << y << ")" << std::endl;
+      abort();
+    }
+#endif
+
+    return true;
+  }
+
+  ////////////////////////////////////////
+  // const from pzprv3 file
+  ////////////////////////////////////////
+  NagareruProblem(const std::string file)
+      : W(0), H(0), num_white_cells(0), num_black_cells(0), num_white_edges(0)
+  {
+    // open file
+    std::ifstream ifs(file, std::ios::in);
+    if (!ifs) throw std::runtime_error(strerror(errno));
+
+    // the first record : pzprv3, nagare, H, W and H rows
+    NagareruReader reader(ifs);
+    NagareruReader::Record r;
+    if (!reader.next(r)) throw std::runtime_error("no pzprv3 record : " + file);
+    if (!r.error.empty()) throw std::runtime_error(file + " : " + r.error);
+    W = r.W;
+    H = r.H;
+
     // close file
     ifs.close();
 
     // initialize
-    C.resize(W * H);
-    D.resize(W * H);
-    for (int i = 0; i < W * H; ++i) {
-      C[i] = Color::No;
-    }
-    setCells(cells);
-    properize();
+    init(r.cells);
+  }
+
+  ////////////////////////////////////////
+  // const from cells : W * H characters of pzprv3 in row major order
+  ////////////////////////////////////////
+  NagareruProblem(const int W, const int H, const std::string& cells)
+      : W(W), H(H), num_white_cells(0), num_black_cells(0), num_white_edges(0)
+  {
+    init(cells);
   }
 
   ////////////////////////////////////////
   // constractor : default
   ////////////////////////////////////////
   NagareruProblem(const int W, const int H)
-      : W(W), H(H), num_white_cells(0), num_white_edges(0)
+      : W(W), H(H), num_white_cells(0), num_black_cells(0), num_white_edges(0)
   {
     C.resize(W * H);
     D.resize(W * H);
     for (int i = 0; i < W * H; ++i) {
       C[i] = Color::No;
     }
+    properize();
   }
 
   ////////////////////////////////////////
@@ -709,6 +1146,7 @@ class NagareruProblem
 
   ////////////////////////////////////////
   // dump the board (with a solution) as dot
+  //   S : indices of E used by the solution
   ////////////////////////////////////////
   void dumpBoard(const std::string file,  const std::set<int>& S=std::set<int>()) const
   {
@@ -732,7 +1170,7 @@ class NagareruProblem
     // Solution
     std::set<int>::iterator itr = S.begin();
     while (itr != S.end()) {
-      int i = E.size() - *itr;
+      const int i = *itr;
       fout << E[i].v1 << "--" << E[i].v2;
       fout << " [color=red, style=bold];" << std::endl;
       ++itr;
@@ -786,6 +1224,18 @@ class NagareruProblem
     fout << "];" << std::endl;
   }
 
+  ////////////////////////////////////////
+  // the problem graph (same as dumpGraph + Graph::readEdges)
+  ////////////////////////////////////////
+  tdzdd::Graph getGraph(void) const
+  {
+    tdzdd::Graph G;
+    for (int i = 0; i < E.size(); ++i)
+      G.addEdge(std::to_string(E[i].v1), std::to_string(E[i].v2));
+    G.update();
+    return G;
+  }
+
   ////////////////////////////////////////
   // dump the problem graph as edge list
   ////////////////////////////////////////
@@ -810,21 +1260,9 @@ class NagareruProblem
     fout << H << std::endl;
     fout << W << std::endl;
 
-    char d;
     for (int y = 1; y <= H; ++y) {
       for (int x = 1; x <= W; ++x) {
-        switch (getColor(x, y)) {
-          case Color::White:
-            d = dtos( getDirection(x, y)[0] )[0];
-            fout << char(d + 32);
-            break;
-          case Color::Black:
-            d = dtos( getDirection(x, y)[0] )[0];
-            fout << d;
-            break;
-          default:
-            fout << ".";
-        }
+        fout << getCellChar(x, y);
         fout << ((x == W) ? "\n" : " ");
       }
     }
@@ -1008,19 +1446,75 @@ class NagareruProblem
 
   ////////////////////////////////////////
   // dump all solutions
+  //   eids[level] : index of E for the item of level
   ////////////////////////////////////////
-  void dumpSolutions(const tdzdd::DdStructure<2>& D, const std::string header) const
+  void dumpSolutions(const tdzdd::DdStructure<2>& D, const std::string header, const std::vector<int>& eids, const size_t max=0) const
   {
     int i = 0;
     tdzdd::DdStructure<2>::const_iterator itr = D.begin();
-    while (itr != D.end()) {
-      std::set<int> S = *itr;
+    while (itr != D.end() && (max == 0 || i < max)) {
+      std::set<int> S;
+      for (std::set<int>::const_iterator l = itr->begin(); l != itr->end(); ++l) {
+        S.insert( eids[*l] );
+      }
       std::ostringstream oss;
       oss << header << "_solution_" << ++i << ".dot";
       dumpBoard(oss.str(), S);
       ++itr;
     }
   }
+
+  ////////////////////////////////////////
+  // a solution in one line
+  //   mask  : E.size() bits in hex, the j-th digit holds E[4j..4j+3] (lsb first)
+  //   cells : a hex digit per cell, the sides used by the loop
+  //           (Up=1, Down=2, Left=4, Right=8), rows separated by '/'
+  ////////////////////////////////////////
+  std::string getSolutionLine(const std::set<int>& S, const bool cells) const
+  {
+    static const char* hex = "0123456789abcdef";
+    std::vector<int> bits(cells ? W * H : (E.size() + 3) / 4, 0);
+
+    for (std::set<int>::const_iterator itr = S.begin(); itr != S.end(); ++itr) {
+      const int i = *itr;
+      if (cells) {
+        bits[ E[i].v1 ] |= 1 << static_cast<int>( getRelativeDirection(E[i].v1, E[i].v2) );
+        bits[ E[i].v2 ] |= 1 << static_cast<int>( getRelativeDirection(E[i].v2, E[i].v1) );
+      }
+      else {
+        bits[i / 4] |= 1 << (i % 4);
+      }
+    }
+
+    std::string line;
+    for (int i = 0; i < bits.size(); ++i) {
+      if (cells && i > 0 && i % W == 0) line += '/';
+      line += hex[ bits[i] ];
+    }
+    return line;
+  }
+
+  ////////////////////////////////////////
+  // stream solutions, one per line, and stop after max (0 = all)
+  //   return # solutions written
+  ////////////////////////////////////////
+  size_t dumpSolutionLines(const tdzdd::DdStructure<2>& D, std::ostream& os, const std::vector<int>& eids,
+                           const bool cells, const size_t max=0) const
+  {
+    size_t n = 0;
+    tdzdd::DdStructure<2>::const_iterator itr = D.begin();
+    while (itr != D.end() && (max == 0 || n < max)) {
+      std::set<int> S;
+      for (std::set<int>::const_iterator l = itr->begin(); l != itr->end(); ++l) {
+        S.insert( eids[*l] );
+      }
+      os << getSolutionLine(S, cells) << '\n';
+      ++n;
+      ++itr;
+    }
+    os.flush();
+    return n;
+  }
 };
 
 }
@@ -3,13 +3,18 @@
 ////////////////////////////////////////
 // include
 ////////////////////////////////////////
+#include <algorithm>
 #include <random>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include <tdzdd/DdSpec.hpp>
 #include <tdzdd/DdStructure.hpp>
 #include <tdzdd/util/Graph.hpp>
 
 #include "NagareruSpec.hpp"
 #include "NagareruProblem.hpp"
+#include "NagareruCounter.hpp"
 
 
 ////////////////////////////////////////
@@ -19,6 +24,19 @@ namespace nagareru
 {
 
 
+////////////////////////////////////////
+// seed of the k-th problem of a batch
+//   it depends only on the master seed and k (not on # threads)
+////////////////////////////////////////
+unsigned int getBatchSeed(const unsigned int seed, const int k)
+{
+  std::seed_seq seq{seed, static_cast<unsigned int>(k)};
+  unsigned int s;
+  seq.generate(&s, &s + 1);
+  return s;
+}
+
+
 ////////////////////////////////////////
 // Nagareru Problem Generator
 ////////////////////////////////////////
@@ -45,6 +63,8 @@ class NagareruProblemGenerator
   // Private member variables
   ////////////////////////////////////////
   bool debug;
+  bool use_mp;
+  size_t mem_limit; // memory limit of each checkUniqueness (0 = unlimited)
   const unsigned seed;
   int num_call_countSolutions;
   std::mt19937_64 random_number_generator;
@@ -76,8 +96,10 @@ class NagareruProblemGenerator
   ////////////////////////////////////////
   // constructor
   ////////////////////////////////////////
-  NagareruProblemGenerator(const unsigned int seed, const bool debug=false) :
+  NagareruProblemGenerator(const unsigned int seed, const bool debug=false, const bool use_mp=false, const size_t mem_limit=0) :
       debug(debug),
+      use_mp(use_mp),
+      mem_limit(mem_limit),
       seed(seed),
       num_call_countSolutions(0),
       random_number_generator(std::mt19937_64(seed))
@@ -103,32 +125,34 @@ class NagareruProblemGenerator
 
   ////////////////////////////////////////
   // generate a random problem
+  //   throw MemoryLimitExceeded if the initial board cannot be checked
   ////////////////////////////////////////
   NagareruProblem generate(const int W, const int H, const int N)
   {
-    std::string cnt = "0";
+    int cnt = 0;
     NagareruProblem P = getInitialBoard(W, H, N);
 
     // generate initial board
-    cnt = countSolutions(P);
-    while (cnt == "0") {
+    cnt = checkUniqueness(P);
+    while (cnt == 0) {
       if (debug) std::cout << "Unsatisfiable Board" << std::endl;
       P = getInitBoard(W, H, N);
-      cnt = countSolutions(P);
+      cnt = checkUniqueness(P);
     }
+    if (cnt < 0) throw MemoryLimitExceeded();
     if (debug) std::cout << "Init : " << cnt << std::endl;
 
     // add & dell
     for (int i = 0; i < 10; i++){
       cnt = addCells(P, cnt);
       cnt = delCells(P, cnt);
-      if (cnt == "1") {
+      if (cnt == 1) {
         break;
       }
     }
 
     // restart if cnt > 1
-    if (cnt == "1") {
+    if (cnt == 1) {
       return P;
     }
     else {
@@ -163,9 +187,10 @@ class NagareruProblemGenerator
 
         // set (x, y) as Black without wind
         P.setCell(x, y, Color::Black, dir);
-        P.properize();
+        P.properize(x, y);
         if (P.isMeaningless() || !P.isConnected()) {
           P.resetCell(x, y);
+          P.properize(x, y);
         }
         else {
           if (++num_added_cell == N) {
@@ -212,18 +237,22 @@ class NagareruProblemGenerator
 
 
   ////////////////////////////////////////
-  // randomlly add a cell to P if possible
+  // randomlly add cells to P while P has solutions
   ////////////////////////////////////////
-  std::string addCells(NagareruProblem &P, std::string prev_cnt)
+  int addCells(NagareruProblem &P, int prev_cnt)
   {
     if (debug) std::cout << "addCells : " << prev_cnt << std::endl;
 
     // P is good
-    if (prev_cnt == "1") return prev_cnt;
+    if (prev_cnt == 1) return prev_cnt;
+
+    // solutions found by the last search
+    std::vector< std::vector< std::pair<int, int> > > sols;
 
     // get addable cells
-    std::vector<Cell> cells = getMeaningfullAddition(P);
-    std::string cnt;
+    std::vector<bool> A = getAddableTable(P);
+    std::vector<Cell> cells = getAddableCells(P, A);
+    int cnt;
 
     // choose one
     while (cells.size() > 0) {
@@ -232,19 +261,59 @@ class NagareruProblemGenerator
       const Cell cell = cells[r];
       cells.erase(cells.begin() + r);
 
-      // add & count
+      // add
       P.setCell(cell.x, cell.y, cell.col, cell.dir);
-      P.properize();
-      cnt = countSolutions(P);
+      P.properize(cell.x, cell.y);
+
+      // A is not updated for the connectivity outside the changed rows & columns
+      if (P.isMeaningless() || !P.isConnected()) {
+        A[ getAddableIndex(P, cell) ] = false;
+        P.resetCell(cell.x, cell.y);
+        P.properize(cell.x, cell.y);
+        continue;
+      }
 
-      // P is valid
-      if (cnt != "0") {
-        return addCells(P, cnt);
+      // count
+      //   P has two or more solutions if two solutions found last survive the
+      //   new cell (a black cell may also add solutions by blocking a wind, but
+      //   cnt >= 2 is all that matters), so search again only if one of them is lost
+      cnt = 0;
+      for (int i = 0; i < sols.size(); ++i) {
+        if (P.isSolution(sols[i])) cnt++;
+      }
+      if (cnt < 2) {
+        std::vector< std::vector< std::pair<int, int> > > found;
+        cnt = checkUniqueness(P, &found);
+        if (cnt > 0) sols.swap(found);
+      }
+
+      // skip the cell if P cannot be checked within mem_limit
+      if (cnt < 0) {
+        A[ getAddableIndex(P, cell) ] = false;
+        P.resetCell(cell.x, cell.y);
+        P.properize(cell.x, cell.y);
+        continue;
+      }
+
+      // P is valid : add the next cell
+      if (cnt != 0) {
+        if (debug) std::cout << "addCells : " << cnt << std::endl;
+        if (cnt == 1) return cnt;
+        prev_cnt = cnt;
+
+        // P0 : P before adding the cell
+        NagareruProblem P0 = P;
+        P0.resetCell(cell.x, cell.y);
+        P0.properize(cell.x, cell.y);
+        updateAddableTable(P0, P, A);
+        cells = getAddableCells(P, A);
+        if (debug) checkAddableCells(P, cells);
+        continue;
       }
 
       // P is invalid : back track
       P.resetCell(cell.x, cell.y);
-      P.properize();
+      P.properize(cell.x, cell.y);
     }
 
     return prev_cnt;
@@ -252,41 +321,70 @@ class NagareruProblemGenerator
 
   ////////////////////////////////////////
   // delete all redundant cells from P
+  //   a cell is redundant if checkUniqueness does not change without it
+  //   cells are checked in the order of (x, y), each against P without the
+  //   redundant cells before it.  With use_mp, the next cells are checked
+  //   in parallel against the current P and the results after the first
+  //   redundant cell are discarded, so P is the same as the serial one.
   ////////////////////////////////////////
-  std::string delCells(NagareruProblem &P, std::string prev_cnt)
+  int delCells(NagareruProblem &P, int prev_cnt)
   {
     if (debug) std::cout << "delCells : " << prev_cnt << std::endl;
 
     bool deleted = false;
 
+    // black & white cells
+    std::vector< std::pair<int, int> > cells;
     for (int x = 1; x <= P.getW(); ++x) {
       for (int y = 1; y <= P.getH(); ++y) {
-        // skip if (x, y) is neither Black nor White
-        Color col = P.getColor(x, y);
-        if (col == Color::No || col == Color::Gray) {
-          continue;
+        const Color col = P.getColor(x, y);
+        if (col == Color::White || col == Color::Black) {
+          cells.push_back( std::make_pair(x, y) );
         }
+      }
+    }
+
+    // # cells checked at once
+    int batch = 1;
+#ifdef _OPENMP
+    if (use_mp) batch = omp_get_max_threads();
+#endif
 
+    int k = 0;
+    while (k < cells.size()) {
+      const int n = std::min<int>(batch, cells.size() - k);
+
+      // cnt[i] : # solutions without cells[k+i] (-1 if meaningless)
+      std::vector<int> cnt(n, -1);
+#pragma omp parallel for schedule(dynamic) if(n > 1)
+      for (int i = 0; i < n; ++i) {
         // del (x,y)
         NagareruProblem Q = P;
-        Q.resetCell(x, y);
-        Q.properize();
+        Q.resetCell(cells[k + i].first, cells[k + i].second);
+        Q.properize(cells[k + i].first, cells[k + i].second);
 
         // skip if Q is meaningless
-        if (Q.isMeaningless()) {
-          continue;
+        if (!Q.isMeaningless()) {
+          cnt[i] = checkUniqueness(Q);
         }
+      }
 
-        // call recursion if (x,y) is redundant
-        const std::string cnt = countSolutions(Q);
-        if (debug) std::cout << x << ", " << y << ", " << cnt << std::endl;
-        if (cnt == prev_cnt) {
+      // delete the first redundant cell
+      int i = 0;
+      for (; i < n; ++i) {
+        const int x = cells[k + i].first;
+        const int y = cells[k + i].second;
+        if (debug && cnt[i] >= 0) std::cout << x << ", " << y << ", " << cnt[i] << std::endl;
+        if (cnt[i] == prev_cnt) {
           P.resetCell(x, y);
-          P.properize();
+          P.properize(x, y);
           deleted = true;
+          break;
         }
       }
+      k += (i < n) ? i + 1 : n;
     }
+
     if (deleted) {
       return delCells(P, prev_cnt);
     }
@@ -295,6 +393,40 @@ class NagareruProblemGenerator
     }
   }
 
+  ////////////////////////////////////////
+  // # solutions of P saturated at 2 : 0, 1 or 2 (= two or more)
+  //   -1 if the search exceeds mem_limit
+  ////////////////////////////////////////
+  int checkUniqueness(const NagareruProblem &P, std::vector< std::vector< std::pair<int, int> > >* sols=NULL)
+  {
+#pragma omp atomic
+    num_call_countSolutions++;
+
+    // P -> G
+    const tdzdd::Graph G = P.getGraph();
+
+    // G -> count
+    NagareruSpec spec(P, G);
+    MemoryBudget budget(mem_limit);
+    if (mem_limit > 0) spec.setMemoryBudget(&budget);
+    NagareruCounter counter(spec);
+    std::vector< std::set<int> > S;
+    const int cnt = counter.countUpTo(2, (sols != NULL) ? &S : NULL);
+    if (budget.isExceeded()) return -1;
+
+    // levels -> edges
+    if (sols != NULL) {
+      const FrontierManager& fm = spec.getFrontierManager();
+      sols->assign(S.size(), std::vector< std::pair<int, int> >());
+      for (int i = 0; i < S.size(); ++i) {
+        for (std::set<int>::const_iterator l = S[i].begin(); l != S[i].end(); ++l) {
+          (*sols)[i].push_back( P.getEdge( fm.getOriginalEdgeId(*l) ) );
+        }
+      }
+    }
+    return cnt;
+  }
+
   ////////////////////////////////////////
   // # solutions of P
   ////////////////////////////////////////
@@ -303,14 +435,11 @@ class NagareruProblemGenerator
     num_call_countSolutions++;
 
     // P -> G
-    const std::string file("__temp__.lst");
-    P.dumpGraph(file);
-    tdzdd::Graph G;
-    G.readEdges(file);
+    const tdzdd::Graph G = P.getGraph();
 
     // G -> ZDD
     NagareruSpec spec(P, G);
-    DdStructure<2> D = tdzdd::DdStructure<2>(spec);
+    DdStructure<2> D = tdzdd::DdStructure<2>(spec, use_mp);
     D.zddReduce();
 
     // count
@@ -321,28 +450,113 @@ class NagareruProblemGenerator
   // get cells that P + the cell is meaningfull
   ////////////////////////////////////////
   std::vector<Cell> getMeaningfullAddition(const NagareruProblem& P) const
+  {
+    return getAddableCells(P, getAddableTable(P));
+  }
+
+  ////////////////////////////////////////
+  // debug : compare cells with the meaningfull additions of P element by element
+  ////////////////////////////////////////
+  void checkAddableCells(const NagareruProblem& P, const std::vector<Cell>& cells) const
+  {
+    const std::vector<Cell> full = getMeaningfullAddition(P);
+    for (size_t k = 0; k < std::max(cells.size(), full.size()); ++k) {
+      if (k < cells.size() && k < full.size() && getAddableIndex(P, cells[k]) == getAddableIndex(P, full[k])) continue;
+      std::cout << "addCells : stale addable cells at " << k << " :";
+      if (k < cells.size()) std::cout << " (" << cells[k].x << ", " << cells[k].y << ", " << ctos(cells[k].col) << ", " << dtos(cells[k].dir) << ")";
+      else std::cout << " (none)";
+      std::cout << " instead of";
+      if (k < full.size()) std::cout << " (" << full[k].x << ", " << full[k].y << ", " << ctos(full[k].col) << ", " << dtos(full[k].dir) << ")";
+      else std::cout << " (none)";
+      std::cout << std::endl;
+      return;
+    }
+  }
+
+  ////////////////////////////////////////
+  // table of meaningfull additions
+  //   A[10 * i + 5 * c + d] : the cell i with color c (0 : White, 1 : Black)
+  //   and direction d is meaningfull
+  ////////////////////////////////////////
+  static int getAddableIndex(const NagareruProblem& P, const Cell& cell)
+  {
+    return 10 * P.getPos(cell.x, cell.y) + 5 * (cell.col == Color::Black) + static_cast<int>(cell.dir);
+  }
+
+  std::vector<bool> getAddableTable(const NagareruProblem& P) const
   {
     NagareruProblem Q = P;
-    std::vector<Cell> cells;
-    std::vector<Color> cols = {Color::White, Color::Black};
+    Q.properize();
+    std::vector<bool> A(10 * P.getW() * P.getH(), false);
+    for (int x = 1; x <= P.getW(); ++x) {
+      for (int y = 1; y <= P.getH(); ++y) {
+        checkAddition(Q, x, y, A);
+      }
+    }
+    return A;
+  }
 
+  // P0 -> P : only the cells in the rows & columns of changed cells and their
+  // neighbors are checked again, since the others have the same winds and
+  // neighbors (the connectivity may change though)
+  void updateAddableTable(const NagareruProblem& P0, const NagareruProblem& P, std::vector<bool>& A) const
+  {
+    const int W = P.getW();
+    const int H = P.getH();
+    std::vector<bool> xs(W + 2, false);
+    std::vector<bool> ys(H + 2, false);
+    for (int x = 1; x <= W; ++x) {
+      for (int y = 1; y <= H; ++y) {
+        if (P0.getColor(x, y) != P.getColor(x, y) || P0.getDirection(x, y) != P.getDirection(x, y)) {
+          xs[x-1] = xs[x] = xs[x+1] = true;
+          ys[y-1] = ys[y] = ys[y+1] = true;
+        }
+      }
+    }
+
+    NagareruProblem Q = P;
+    for (int x = 1; x <= W; ++x) {
+      for (int y = 1; y <= H; ++y) {
+        if (xs[x] || ys[y]) checkAddition(Q, x, y, A);
+      }
+    }
+  }
+
+  // Q : a properized copy of P (restored after each trial)
+  void checkAddition(NagareruProblem& Q, const int x, const int y, std::vector<bool>& A) const
+  {
+    const int i = Q.getPos(x, y);
+    for (int k = 0; k < 10; ++k) {
+      A[10 * i + k] = false;
+    }
+
+    // skip (x, y) if it is white or black
+    if (Q.getColor(x, y) == Color::White) return;
+    if (Q.getColor(x, y) == Color::Black) return;
+
+    // try to change (x, y)
+    for (int c = 0; c < 2; ++c) {
+      for (int d = 0; d < 5; ++d) {
+        Q.setCell(x, y, (c == 0) ? Color::White : Color::Black, static_cast<Direction>(d));
+        Q.properize(x, y);
+        A[10 * i + 5 * c + d] = (!Q.isMeaningless() && Q.isConnected());
+        Q.resetCell(x, y);
+        Q.properize(x, y);
+      }
+    }
+  }
+
+  std::vector<Cell> getAddableCells(const NagareruProblem& P, const std::vector<bool>& A) const
+  {
+    std::vector<Cell> cells;
     for (int x = 1; x <= P.getW(); ++x) {
       for (int y = 1; y <= P.getH(); ++y) {
-        // skip (x, y) if it is white or black
-        if (Q.getColor(x, y) == Color::White) continue;
-        if (Q.getColor(x, y) == Color::Black) continue;
-
-        // try to change (x, y)
-        for (int i = 0; i < cols.size(); ++i) {
-          const Color col = cols[i];
-          for (int j = 0; j < 5; ++j) {
-            const Direction dir = static_cast<Direction>(j);
-            Q.setCell(x, y, col, dir);
-            Q.properize();
-            if (!Q.isMeaningless() && Q.isConnected()) {
-              cells.push_back(Cell(x, y, col, dir));
+        const int i = P.getPos(x, y);
+        for (int c = 0; c < 2; ++c) {
+          for (int d = 0; d < 5; ++d) {
+            if (A[10 * i + 5 * c + d]) {
+              cells.push_back(Cell(x, y, (c == 0) ? Color::White : Color::Black, static_cast<Direction>(d)));
             }
-            Q.resetCell(x, y);
           }
         }
       }
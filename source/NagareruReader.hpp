@@ -0,0 +1,145 @@
+#pragma once
+
+////////////////////////////////////////
+// include
+////////////////////////////////////////
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <string>
+
+
+////////////////////////////////////////
+// namespace
+////////////////////////////////////////
+namespace nagareru
+{
+
+////////////////////////////////////////
+// Nagareru Reader : concatenated pzprv3 records of a file or stdin
+//   the whole input is read at once, and a record starts at a "pzprv3" line
+//   (lines after the board of a record, e.g. the answer, are ignored)
+////////////////////////////////////////
+class NagareruReader
+{
+ public:
+
+  struct Record {
+    size_t index = 0;    // index of the record (from 0)
+    size_t offset = 0;   // byte offset of the record in the input
+    int W = 0;           // width
+    int H = 0;           // height
+    std::string cells;   // W * H characters of pzprv3 in row major order
+    std::string error;   // empty if valid
+  };
+
+ private:
+
+  std::string buf;       // the input
+  size_t pos;            // offset of the next line
+  size_t line_no;        // # the next line (from 1)
+  size_t num_records;    // # records read so far
+  size_t last_pos;       // pos and line_no before getLine()
+  size_t last_line_no;
+
+  // the next line without "\n" or "\r\n"
+  bool getLine(std::string& line)
+  {
+    if (pos >= buf.size()) return false;
+    last_pos = pos;
+    last_line_no = line_no;
+    size_t end = buf.find('\n', pos);
+    if (end == std::string::npos) end = buf.size();
+    size_t len = end - pos;
+    if (len > 0 && buf[pos + len - 1] == '\r') len--;
+    line.assign(buf, pos, len);
+    pos = end + 1;
+    line_no++;
+    return true;
+  }
+
+  // the next line of the board, false at the end or at the next "pzprv3" line
+  bool getBoardLine(std::string& line)
+  {
+    if (!getLine(line)) return false;
+    if (line != "pzprv3") return true;
+    pos = last_pos;
+    line_no = last_line_no;
+    return false;
+  }
+
+  // a positive integer of a whole line (0 if not)
+  static int toSize(const std::string& line)
+  {
+    if (line.empty() || line.size() > 4 || line.find_first_not_of("0123456789") != std::string::npos) return 0;
+    return std::stoi(line);
+  }
+
+  // read the rest of a record after its "pzprv3" line, and return an error message (empty if valid)
+  std::string readBoard(Record& r)
+  {
+    std::string line;
+
+    // puzzle name, H and W
+    if (!getBoardLine(line)) return "truncated record";
+    if (line != "nagare") return "not a nagare puzzle : " + line;
+    if (!getBoardLine(line)) return "truncated record";
+    if ((r.H = toSize(line)) == 0) return "invalid height : " + line;
+    if (!getBoardLine(line)) return "truncated record";
+    if ((r.W = toSize(line)) == 0) return "invalid width : " + line;
+
+    // rows
+    r.cells.resize((size_t)r.W * r.H);
+    for (int y = 0; y < r.H; ++y) {
+      if (!getBoardLine(line)) return "truncated record";
+      if ((int)line.size() < 2 * r.W - 1) return "too short row " + std::to_string(y + 1);
+      for (int x = 0; x < r.W; ++x) {
+        const char c = line[2 * x];
+        if (c == '\0' || strchr(".UDLRNudlrn", c) == NULL) {
+          return "invalid cell '" + std::string(1, c) + "' at (" + std::to_string(x + 1) + ", " + std::to_string(y + 1) + ")";
+        }
+        r.cells[(size_t)r.W * y + x] = c;
+      }
+    }
+    return "";
+  }
+
+ public:
+
+  NagareruReader(std::istream& is) : pos(0), line_no(1), num_records(0), last_pos(0), last_line_no(1)
+  {
+    std::ostringstream oss;
+    oss << is.rdbuf();
+    buf = oss.str();
+  }
+
+  // the next record (possibly with an error), false at the end of the input
+  bool next(Record& r)
+  {
+    std::string line;
+
+    // skip to a "pzprv3" line : a non-empty line before the first record is a bad record
+    size_t offset = pos;
+    while (true) {
+      offset = pos;
+      if (!getLine(line)) return false;
+      if (line == "pzprv3") break;
+      if (num_records == 0 && line.find_first_not_of(" \t") != std::string::npos) break;
+    }
+
+    r.index = num_records++;
+    r.offset = offset;
+    r.W = r.H = 0;
+    r.cells.clear();
+    r.error = (line == "pzprv3") ? readBoard(r) : "no pzprv3 header";
+    if (!r.error.empty()) r.error = "line " + std::to_string(line_no - 1) + " : " + r.error;
+    return true;
+  }
+
+  size_t getNumRecords() const
+  {
+    return num_records;
+  }
+};
+
+}
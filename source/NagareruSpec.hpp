@@ -3,8 +3,11 @@
 ////////////////////////////////////////
 // include
 ////////////////////////////////////////
+#include <cstdint>
 #include "FrontierManager.hpp"
 #include "NagareruProblem.hpp"
+#include "NagareruStats.hpp"
+#include "NagareruMemory.hpp"
 
 
 ////////////////////////////////////////
@@ -14,19 +17,40 @@ namespace nagareru
 {
 
 
+////////////////////////////////////////
+// layout of states
+//   1 : packed into 1 or 2 bytes per vertex (default)
+//   0 : one struct per vertex
+////////////////////////////////////////
+#ifndef NAGARERU_PACKED_STATE
+#define NAGARERU_PACKED_STATE 1
+#endif
+
+
 ////////////////////////////////////////
 // state of a vertex : comp
 ////////////////////////////////////////
+#if NAGARERU_PACKED_STATE
+// a vertex uses 1 byte if the width <= 15, 2 bytes otherwise
+//   bits [0, b)     : M = (position of mate) + 1, or 0 if no mate
+//   bit  b          : U
+//   bits [b+1, b+4) : N
+// where b = 4 (1 byte) or 12 (2 bytes)
+typedef uint8_t NagareruState;
+#else
 class NagareruState {
  public:
   int  M;       // mate
   bool U;       // upper or not
   Direction N;  // relative direction from neighbors to self
 };
+#endif
 
 
 ////////////////////////////////////////
 // Spec of Nagareru
+//   getRoot/getChild only read const members, so copies of a spec
+//   can be used by the OpenMP builder of TdZdd in parallel.
 ////////////////////////////////////////
 class NagareruSpec : public tdzdd::PodArrayDdSpec<NagareruSpec, NagareruState, 2>
 {
@@ -39,12 +63,110 @@ class NagareruSpec : public tdzdd::PodArrayDdSpec<NagareruSpec, NagareruState, 2
   const tdzdd::Graph& G;
   const FrontierManager fm;
 
+  // edge information of each level
+  struct LevelInfo {
+    int v1;             // vertex v1
+    int v2;             // vertex v2
+    int ci1;            // cell index of v1
+    int ci2;            // cell index of v2
+    Color c1;           // color of v1
+    Color c2;           // color of v2
+    int ds1;            // direction mask of v1
+    int ds2;            // direction mask of v2
+    Direction v1_to_v2; // relative direction from v1 to v2
+    Direction v2_to_v1; // relative direction from v2 to v1
+    int nm1;            // values of N of v1 compared at lower levels
+    int nm2;            // values of N of v2 compared at lower levels
+  };
+  std::vector<LevelInfo> LI; // LI[level]
+  int white_level;           // the lowest level of white edges
+
+  // connected components of the lower edges after each level
+  static const int MAX_COMPONENTS = 64;
+  struct Lookahead {
+    int nc;               // # components having remaining frontier vertices
+    bool wsplit;          // white cells not entered yet are in >1 components
+    bool wout;            // ... are in a component without frontier vertices
+    std::vector<int> pc;  // pc[p] : component of the vertex at position p
+    std::vector<int> wcs; // components having white cells not entered yet
+  };
+  std::vector<Lookahead> LA; // LA[level]
+
+#if NAGARERU_PACKED_STATE
+  int stride; // # bytes per vertex
+  int mbits;  // # bits of M
+#endif
+
+  // counters of getChild (shared by copies, only with NAGARERU_STATS)
+  NagareruStats* stats;
+
+  // memory budget (shared by copies) : getChild prunes everything over it
+  MemoryBudget* budget;
+  size_t child_bytes; // bytes charged to budget per getChild : a node and a state
+
   ////////////////////////////////////////
   // accessors
   ////////////////////////////////////////
  private:
 
-  int getM(NagareruState* s, const int v) const
+#if NAGARERU_PACKED_STATE
+  unsigned getSlotAt(const NagareruState* s, const int i) const
+  {
+    const int p = stride * i;
+    return (stride == 1) ? s[p] : (s[p] | (s[p+1] << 8));
+  }
+
+  void setSlotAt(NagareruState* s, const int i, const unsigned x) const
+  {
+    const int p = stride * i;
+    s[p] = x & 0xff;
+    if (stride == 2) s[p+1] = x >> 8;
+  }
+
+  unsigned getSlot(const NagareruState* s, const int v) const
+  {
+    return getSlotAt(s, fm.getPositionOf(v));
+  }
+
+  void setSlot(NagareruState* s, const int v, const unsigned x) const
+  {
+    setSlotAt(s, fm.getPositionOf(v), x);
+  }
+
+  int getM(NagareruState* s, const int level, const int v) const
+  {
+    const unsigned m = getSlot(s, v) & ((1u << mbits) - 1);
+    return (m == 0) ? 0 : fm.getVertexOf(level, m - 1);
+  }
+
+  bool getU(NagareruState *s, const int v) const
+  {
+    return (getSlot(s, v) >> mbits) & 1u;
+  }
+
+  Direction getN(NagareruState* s, const int v) const
+  {
+    return static_cast<Direction>(getSlot(s, v) >> (mbits + 1));
+  }
+
+  void setM(NagareruState* s, const int v, const int u) const
+  {
+    const unsigned m = (u == 0) ? 0 : fm.getPositionOf(u) + 1;
+    setSlot(s, v, (getSlot(s, v) & ~((1u << mbits) - 1)) | m);
+  }
+
+  void setU(NagareruState *s, const int v, const bool b) const
+  {
+    setSlot(s, v, (getSlot(s, v) & ~(1u << mbits)) | (b ? (1u << mbits) : 0));
+  }
+
+  void setN(NagareruState *s, const int v, const Direction d) const
+  {
+    const unsigned x = getSlot(s, v) & ((1u << (mbits + 1)) - 1);
+    setSlot(s, v, x | (static_cast<unsigned>(d) << (mbits + 1)));
+  }
+#else
+  int getM(NagareruState* s, const int level, const int v) const
   {
     return s[ fm.getPositionOf(v) ].M;
   }
@@ -73,6 +195,7 @@ class NagareruSpec : public tdzdd::PodArrayDdSpec<NagareruSpec, NagareruState, 2
   {
     s[ fm.getPositionOf(v) ].N = d;
   }
+#endif
 
   ////////////////////////////////////////
   // Initialize
@@ -81,11 +204,21 @@ class NagareruSpec : public tdzdd::PodArrayDdSpec<NagareruSpec, NagareruState, 2
 
   void initializeState(NagareruState* s) const
   {
+#if NAGARERU_PACKED_STATE
+    // clear whole array including padding since it is hashed word by word
+    for (int i = 0; i < getArraySize(); ++i){
+      s[i] = 0;
+    }
+    for (int i = 0; i < fm.getWidth(); ++i){
+      setSlotAt(s, i, static_cast<unsigned>(Direction::No) << (mbits + 1));
+    }
+#else
     for (int i = 0; i < fm.getWidth(); ++i){
       s[i].M = 0;
       s[i].U = false;
       s[i].N = Direction::No;
     }
+#endif
   }
 
   ////////////////////////////////////////
@@ -98,6 +231,192 @@ class NagareruSpec : public tdzdd::PodArrayDdSpec<NagareruSpec, NagareruState, 2
     return std::stoi( G.vertexName(v) );
   }
 
+  static int getMask(const Direction d)
+  {
+    return 1 << static_cast<int>(d);
+  }
+
+  static int getMask(const std::vector<Direction>& ds)
+  {
+    int mask = 0;
+    for (int i = 0; i < ds.size(); ++i) {
+      mask |= getMask(ds[i]);
+    }
+    return mask;
+  }
+
+  static std::vector<std::pair<int, int> > getCoordinates(const NagareruProblem& P, const tdzdd::Graph& G)
+  {
+    std::vector<std::pair<int, int> > XY(G.vertexSize() + 1);
+    for (int v = 1; v <= G.vertexSize(); ++v) {
+      const int ci = std::stoi( G.vertexName(v) );
+      XY[v] = std::make_pair(ci % P.getW(), ci / P.getW());
+    }
+    return XY;
+  }
+
+  void constructLevelInfo()
+  {
+    LI.resize(fm.getEdgeSize() + 1);
+    white_level = fm.getEdgeSize();
+    for (int level = fm.getEdgeSize(); level > 0; --level) {
+      LevelInfo& li = LI[level];
+      li.v1  = fm.getV1(level);
+      li.v2  = fm.getV2(level);
+      li.ci1 = getCellId(li.v1);
+      li.ci2 = getCellId(li.v2);
+      li.c1  = P.getColor(li.ci1);
+      li.c2  = P.getColor(li.ci2);
+      li.ds1 = getMask( P.getDirection(li.ci1) );
+      li.ds2 = getMask( P.getDirection(li.ci2) );
+      li.v1_to_v2 = P.getRelativeDirection(li.ci1, li.ci2);
+      li.v2_to_v1 = P.getRelativeDirection(li.ci2, li.ci1);
+      if (li.c1 == Color::White || li.c2 == Color::White) {
+        white_level = level;
+      }
+    }
+
+    // N of a gray vertex v is compared with the direction of a lower edge
+    // (v, w) when v has a direction crossing the edge
+    std::vector<int> nm(fm.getVertexSize() + 1, 0);
+    for (int level = 1; level <= fm.getEdgeSize(); ++level) {
+      LevelInfo& li = LI[level];
+      const int e12 = getMask(li.v1_to_v2);
+      const int e21 = getMask(li.v2_to_v1);
+      li.nm1 = nm[li.v1];
+      li.nm2 = nm[li.v2];
+      if (li.c1 == Color::Gray && (li.ds1 & ~(e12 | e21))) nm[li.v1] |= e12;
+      if (li.c2 == Color::Gray && (li.ds2 & ~(e12 | e21))) nm[li.v2] |= e21;
+    }
+  }
+
+  static int find(std::vector<int>& uf, int v)
+  {
+    while (uf[v] != v) {
+      v = uf[v] = uf[uf[v]];
+    }
+    return v;
+  }
+
+  void constructLookahead()
+  {
+    const int n = fm.getVertexSize();
+    const int m = fm.getEdgeSize();
+    LA.resize(m + 1);
+
+    // white vertices and the levels they enter
+    std::vector<int> whites;
+    std::vector<int> enter(n + 1, 0);
+    for (int level = m; level > 0; --level) {
+      const std::vector<int>& E = fm.getE(level);
+      for (int i = 0; i < E.size(); ++i) {
+        enter[ E[i] ] = level;
+        if (P.getColor( getCellId(E[i]) ) == Color::White) {
+          whites.push_back( E[i] );
+        }
+      }
+    }
+
+    // uf contains the edges of levels < level
+    std::vector<int> uf(n + 1);
+    for (int v = 0; v <= n; ++v) {
+      uf[v] = v;
+    }
+    for (int level = 1; level <= m; ++level) {
+      Lookahead& la = LA[level];
+      const std::vector<int>& R = fm.getR(level);
+
+      // components of R
+      std::vector<int> roots;
+      la.pc.assign(fm.getWidth(), -1);
+      for (int i = 0; i < R.size(); ++i) {
+        const int r = find(uf, R[i]);
+        const int c = std::find(roots.begin(), roots.end(), r) - roots.begin();
+        if (c == roots.size()) roots.push_back(r);
+        la.pc[ fm.getPositionOf(R[i]) ] = c;
+      }
+      la.nc = roots.size();
+
+      // components of white vertices not entered yet
+      int wroot = -1;
+      la.wsplit = false;
+      la.wout = false;
+      for (int i = 0; i < whites.size(); ++i) {
+        if (enter[ whites[i] ] >= level) continue;
+        const int r = find(uf, whites[i]);
+        if (wroot >= 0 && wroot != r) la.wsplit = true;
+        wroot = r;
+        const int c = std::find(roots.begin(), roots.end(), r) - roots.begin();
+        if (c == roots.size()) {
+          la.wout = true;
+        }
+        else if (std::find(la.wcs.begin(), la.wcs.end(), c) == la.wcs.end()) {
+          la.wcs.push_back(c);
+        }
+      }
+
+      // add the edge of level
+      uf[ find(uf, fm.getV1(level)) ] = find(uf, fm.getV2(level));
+    }
+  }
+
+  ////////////////////////////////////////
+  // lookahead : can path ends and white cells not entered yet form a cycle
+  // with the lower edges?  Each component of the lower edges must have an
+  // even number of path ends, every component with such white cells must
+  // have a path end, and the components must be connected by the paths.
+  ////////////////////////////////////////
+  bool isReachable(NagareruState* s, const int level) const
+  {
+    const Lookahead& la = LA[level];
+    if (la.nc > MAX_COMPONENTS) return true;
+
+    int cnt[MAX_COMPONENTS];
+    int uf[MAX_COMPONENTS];
+    for (int c = 0; c < la.nc; ++c) {
+      cnt[c] = 0;
+      uf[c] = c;
+    }
+
+    // path ends
+    bool ends = false;
+    const std::vector<int>& R = fm.getR(level);
+    for (int i = 0; i < R.size(); ++i) {
+      const int v = R[i];
+      const int m = getM(s, level, v);
+      if (m == 0 || m == v) continue;
+      ends = true;
+      int a = la.pc[ fm.getPositionOf(v) ];
+      int b = la.pc[ fm.getPositionOf(m) ];
+      cnt[a]++;
+      while (uf[a] != a) a = uf[a];
+      while (uf[b] != b) b = uf[b];
+      uf[a] = b;
+    }
+
+    // no paths yet
+    if (!ends) return !la.wsplit;
+
+    // white cells that no path can reach
+    if (la.wout) return false;
+    for (int i = 0; i < la.wcs.size(); ++i) {
+      if (cnt[ la.wcs[i] ] == 0) return false;
+    }
+
+    // parity & connectivity
+    int root = -1;
+    for (int c = 0; c < la.nc; ++c) {
+      if (cnt[c] == 0) continue;
+      if (cnt[c] & 1) return false;
+      int r = c;
+      while (uf[r] != r) r = uf[r];
+      if (root >= 0 && root != r) return false;
+      root = r;
+    }
+
+    return true;
+  }
+
   ////////////////////////////////////////
   // print state
   ////////////////////////////////////////
@@ -105,21 +424,18 @@ class NagareruSpec : public tdzdd::PodArrayDdSpec<NagareruSpec, NagareruState, 2
 
   void printState(NagareruState* s, const int level, std::ostream& os=std::cout) const
   {
-    const int v1  = fm.getV1(level);
-    const int v2  = fm.getV2(level);
-    const int ci1 = getCellId(v1);
-    const int ci2 = getCellId(v2);
+    const LevelInfo& li = LI[level];
 
     os << "<<<< level = " << level << " >>>>" << std::endl;
-    os << "v1 = " << v1 << " (ci1 = " << ci1 << ")"  << std::endl;
-    os << "v2 = " << v2 << " (ci2 = " << ci2 << ")" << std::endl;
-    os << "edge direction = " << dtos( P.getRelativeDirection(ci1, ci2) ) << std::endl;
+    os << "v1 = " << li.v1 << " (ci1 = " << li.ci1 << ")"  << std::endl;
+    os << "v2 = " << li.v2 << " (ci2 = " << li.ci2 << ")" << std::endl;
+    os << "edge direction = " << dtos( li.v1_to_v2 ) << std::endl;
 
     // frontier infromation
     const std::vector<int>& F = fm.getF(level);
     for (int i = 0; i < F.size(); ++i) {
       const int v = F[i];
-      const int m = getM(s, v);
+      const int m = getM(s, level, v);
       const Direction n = getN(s, v);
       const bool u = getU(s, v);
       std::string dir = dtos(n);
@@ -133,10 +449,74 @@ class NagareruSpec : public tdzdd::PodArrayDdSpec<NagareruSpec, NagareruState, 2
   ////////////////////////////////////////
  public:
 
-  NagareruSpec(const NagareruProblem& _P, const tdzdd::Graph& _G)
-      : P(_P), G(_G), fm(_G)
+  NagareruSpec(const NagareruProblem& _P, const tdzdd::Graph& _G, const EdgeOrder order=EdgeOrder::Best)
+      : P(_P), G(_G), fm(_G, getCoordinates(_P, _G), order), stats(NULL), budget(NULL), child_bytes(0)
   {
+#if NAGARERU_PACKED_STATE
+    // M must hold the positions 1..w
+    if (fm.getWidth() < (1 << 4)) {
+      stride = 1;
+      mbits  = 4;
+    }
+    else if (fm.getWidth() < (1 << 12)) {
+      stride = 2;
+      mbits  = 12;
+    }
+    else {
+      throw std::runtime_error("NagareruSpec : too wide frontier");
+    }
+
+    // round up to words
+    const int word = sizeof(size_t);
+    setArraySize( (stride * fm.getWidth() + word - 1) / word * word );
+#else
     setArraySize( fm.getWidth() );
+#endif
+
+    constructLevelInfo();
+    constructLookahead();
+  }
+
+  ////////////////////////////////////////
+  // accessors
+  ////////////////////////////////////////
+ public:
+
+  const FrontierManager& getFrontierManager() const
+  {
+    return fm;
+  }
+
+  // # elements of a state array
+  int getStateSize() const
+  {
+    return getArraySize();
+  }
+
+  // count getChild into st (only with NAGARERU_STATS)
+  void setStats(NagareruStats* st)
+  {
+    stats = st;
+  }
+
+  // stop the construction once its children exceed the budget b
+  void setMemoryBudget(MemoryBudget* b)
+  {
+    budget = b;
+    child_bytes = MemoryBudget::NODE_BYTES + getStateSize() * sizeof(NagareruState);
+  }
+
+  ////////////////////////////////////////
+  // x as the result of getChild by the reason r
+  ////////////////////////////////////////
+ private:
+
+  int record(const int level, const int value, const NagareruStats::Reason r, const int x) const
+  {
+#if NAGARERU_STATS
+    if (stats != NULL) stats->count(level, value, r);
+#endif
+    return x;
   }
 
   ////////////////////////////////////////
@@ -157,6 +537,11 @@ class NagareruSpec : public tdzdd::PodArrayDdSpec<NagareruSpec, NagareruState, 2
 
   int getChild(NagareruState* s, const int level, const int value) const
   {
+    // Pruning : out of the memory budget
+    if (budget != NULL && !budget->charge(level, child_bytes)) {
+      return record(level, value, NagareruStats::Memory, 0);
+    }
+
     ////////////////////////////////////////
     // vertices that should be checked
     ////////////////////////////////////////
@@ -177,29 +562,29 @@ class NagareruSpec : public tdzdd::PodArrayDdSpec<NagareruSpec, NagareruState, 2
     ////////////////////////////////////////
     // edge information
     ////////////////////////////////////////
-    // edge (v1, v2)
-    const int v1 = fm.getV1(level);
-    const int v2 = fm.getV2(level);
+    const LevelInfo& li = LI[level];
 
-    // cell index of the original problem
-    const int ci1 = getCellId(v1);
-    const int ci2 = getCellId(v2);
+    // edge (v1, v2)
+    const int v1 = li.v1;
+    const int v2 = li.v2;
 
     // color of v1/v2
-    const Color c1 = P.getColor(ci1);
-    const Color c2 = P.getColor(ci2);
+    const Color c1 = li.c1;
+    const Color c2 = li.c2;
 
-    // directions of v1/v2
-    const std::vector<Direction>& ds1 = P.getDirection(ci1);
-    const std::vector<Direction>& ds2 = P.getDirection(ci2);
+    // direction masks of v1/v2
+    const int ds1 = li.ds1;
+    const int ds2 = li.ds2;
 
     // relative direction of v1/v2
-    const Direction v1_to_v2 = P.getRelativeDirection(ci1, ci2);
-    const Direction v2_to_v1 = P.getRelativeDirection(ci2, ci1);
+    const Direction v1_to_v2 = li.v1_to_v2;
+    const Direction v2_to_v1 = li.v2_to_v1;
+    const int e12 = getMask(v1_to_v2);
+    const int e21 = getMask(v2_to_v1);
 
     // mate of v1/v2
-    const int m1 = getM(s, v1);
-    const int m2 = getM(s, v2);
+    const int m1 = getM(s, level, v1);
+    const int m2 = getM(s, level, v2);
 
     // relative directin from its neighbor to v1/v2
     const Direction n1 = getN(s, v1);
@@ -220,66 +605,42 @@ class NagareruSpec : public tdzdd::PodArrayDdSpec<NagareruSpec, NagareruState, 2
       ////////////////////////////////////////
       // Pruning : detect branch
       if (m1 == 0 || m2 == 0){
-        return 0;
+        return record(level, value, NagareruStats::Branch, 0);
       }
 
       // Pruning : detect backflow by connecting two paths
       if ((u_v1 && u_v2) || (u_m1 && u_m2)){
-        return 0;
+        return record(level, value, NagareruStats::Backflow, 0);
       }
 
       // Pruning : the edge flows backward
       if (c1 == Color::White || c1 == Color::Gray) {
         // v side is upper -> flow must be (v -> u)
         if(u_m1 || u_v2){
-          for (int i = 0; i < ds1.size(); ++i){
-            if (v2_to_v1 == ds1[i]){
-              return 0;
-            }
-          }
+          if (ds1 & e21) return record(level, value, NagareruStats::Backward, 0);
         }
         // u side is upper -> flow must be (v <- u)
         else if(u_m2 || u_v1){
-          for (int i = 0; i < ds1.size() ; ++i){
-            if (v1_to_v2 == ds1[i]){
-              return 0;
-            }
-          }
+          if (ds1 & e12) return record(level, value, NagareruStats::Backward, 0);
         }
       }
       if (c2 == Color::White || c2 == Color::Gray) {
         // u side is upper -> flow must be (u -> v)
         if(u_m2 || u_v1){
-          for (int i = 0; i < ds2.size(); ++ i){
-            if (v1_to_v2 == ds2[i]){
-              return 0;
-            }
-          }
+          if (ds2 & e12) return record(level, value, NagareruStats::Backward, 0);
         }
         // v side is upper -> flow must be (v -> u)
         else if(u_m1 || u_v2){
-          for (int i = 0; i < ds2.size(); ++ i){
-            if (v2_to_v1 == ds2[i]){
-              return 0;
-            }
-          }
+          if (ds2 & e21) return record(level, value, NagareruStats::Backward, 0);
         }
       }
 
       // Pruning : ignore a gray flow two times in a row
       if (c1 == Color::Gray) {
-        for (int i = 0; i < ds1.size(); ++i){
-          if (n1==v1_to_v2 && v1_to_v2!=ds1[i] && v2_to_v1!=ds1[i]){
-            return 0;
-          }
-        }
+        if (n1==v1_to_v2 && (ds1 & ~(e12 | e21))) return record(level, value, NagareruStats::GrayTwice, 0);
       }
       if (c2 == Color::Gray) {
-        for (int i = 0; i < ds2.size(); ++i){
-          if (n2==v2_to_v1 && v1_to_v2!=ds2[i] && v2_to_v1!=ds2[i]){
-            return 0;
-          }
-        }
+        if (n2==v2_to_v1 && (ds2 & ~(e12 | e21))) return record(level, value, NagareruStats::GrayTwice, 0);
       }
 
       // Pruning : detect cycle
@@ -287,21 +648,20 @@ class NagareruSpec : public tdzdd::PodArrayDdSpec<NagareruSpec, NagareruState, 2
         // there is a redundant fragment
         for (int i = 0; i < F.size(); ++i){
           const int v = F[i];
-          const int m = getM(s, v);
+          const int m = getM(s, level, v);
           if (v!=v1 && v!=v2 && m!=0 && m!=v){
-            return 0;
+            return record(level, value, NagareruStats::CycleFragment, 0);
           }
         }
 
         // there is non-used white edge
-        //        if (ss < P.getNumWhiteEdges() ){
-        if (fm.getEdgeSize() - level < P.getLastWhiteEdge() ) {
-          return 0;
+        if (level > white_level) {
+          return record(level, value, NagareruStats::CycleWhite, 0);
         }
 
         // successfully construct a cycle
         else {
-          return -1;
+          return record(level, value, NagareruStats::Cycle, -1);
         }
       }
 
@@ -320,33 +680,35 @@ class NagareruSpec : public tdzdd::PodArrayDdSpec<NagareruSpec, NagareruState, 2
 
       // update U : the edge flows along the cell direction
       if (c1 == Color::White || c1 == Color::Gray){
-        for (int i = 0; i < ds1.size(); ++i){
-          if (v1_to_v2 == ds1[i]) {
-            if (u_m2 || u_v1) return 0;
-            setU(s, m1, true);
-          }
-          else if (v2_to_v1 == ds1[i]) {
-            if (u_m1 || u_v2) return 0;
-            setU(s, m2, true);
-          }
+        if (ds1 & e12) {
+          if (u_m2 || u_v1) return record(level, value, NagareruStats::Upper, 0);
+          setU(s, m1, true);
+        }
+        if (ds1 & e21) {
+          if (u_m1 || u_v2) return record(level, value, NagareruStats::Upper, 0);
+          setU(s, m2, true);
         }
       }
       if (c2 == Color::White || c2 == Color::Gray){
-        for (int i = 0; i < ds2.size(); ++i){
-          if (v1_to_v2 == ds2[i]) {
-            if (u_m2 || u_v1) return 0;
-            setU(s, m1, true);
-          }
-          else if (v2_to_v1 == ds2[i]) {
-            if (u_m1 || u_v2) return 0;
-            setU(s, m2, true);
-          }
+        if (ds2 & e12) {
+          if (u_m2 || u_v1) return record(level, value, NagareruStats::Upper, 0);
+          setU(s, m1, true);
+        }
+        if (ds2 & e21) {
+          if (u_m1 || u_v2) return record(level, value, NagareruStats::Upper, 0);
+          setU(s, m2, true);
         }
       }
       if (m1 != v1 && u_v1) setU(s, m2, true);
       if (m2 != v2 && u_v2) setU(s, m1, true);
       if (m1 != v1) setU(s, v1, false);
       if (m2 != v2) setU(s, v2, false);
+
+      ////////////////////////////////////////
+      // Normalize : N that is never compared again
+      ////////////////////////////////////////
+      if (!(li.nm1 & getMask(getN(s, v1)))) setN(s, v1, Direction::No);
+      if (!(li.nm2 & getMask(getN(s, v2)))) setN(s, v2, Direction::No);
     }
 
     ////////////////////////////////////////
@@ -355,7 +717,7 @@ class NagareruSpec : public tdzdd::PodArrayDdSpec<NagareruSpec, NagareruState, 2
     else {
       // pruning : omit a white edge
       if (c1 == Color::White || c2 == Color::White) {
-        return 0;
+        return record(level, value, NagareruStats::OmitWhite, 0);
       }
     }
 
@@ -364,11 +726,11 @@ class NagareruSpec : public tdzdd::PodArrayDdSpec<NagareruSpec, NagareruState, 2
     ////////////////////////////////////////
     for (int i = 0; i < L.size(); ++i) {
       const int v = L[i];
-      const int m = getM(s, v);
+      const int m = getM(s, level, v);
 
       // Pruning : v is fixed as an endpoint
       if (m != 0 && m != v){
-        return 0;
+        return record(level, value, NagareruStats::Endpoint, 0);
       }
 
       // initalize state
@@ -377,12 +739,17 @@ class NagareruSpec : public tdzdd::PodArrayDdSpec<NagareruSpec, NagareruState, 2
       setU(s, v, false);
     }
 
+    // Pruning : the lower edges cannot complete a cycle
+    if (!isReachable(s, level)) {
+      return record(level, value, NagareruStats::Unreachable, 0);
+    }
+
     // Pruning : reach the last edge without completing a cycle
     if (level == 1){
-      return 0;
+      return record(level, value, NagareruStats::LastLevel, 0);
     }
 
-    return level - 1;
+    return record(level, value, NagareruStats::Next, level - 1);
   }
 };
 
@@ -0,0 +1,148 @@
+#pragma once
+
+////////////////////////////////////////
+// include
+////////////////////////////////////////
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+
+////////////////////////////////////////
+// getChild counters
+//   0 : compiled out (default)
+//   1 : NagareruSpec counts getChild calls per level, value and reason
+////////////////////////////////////////
+#ifndef NAGARERU_STATS
+#define NAGARERU_STATS 0
+#endif
+
+
+////////////////////////////////////////
+// namespace
+////////////////////////////////////////
+namespace nagareru
+{
+
+////////////////////////////////////////
+// Nagareru Stats : per-level statistics of a construction
+////////////////////////////////////////
+class NagareruStats
+{
+ public:
+
+  // results of getChild
+  enum Reason : int {
+    Branch = 0,    // take : an endpoint already has degree 2
+    Backflow,      // take : connect two paths against their flows
+    Backward,      // take : the edge flows against a direction
+    GrayTwice,     // take : go straight twice through a gray cell
+    CycleFragment, // take : close a cycle with another fragment left
+    CycleWhite,    // take : close a cycle before the last white edge
+    Cycle,         // take : close the cycle (1-terminal)
+    Upper,         // take : the flow conflicts with an upper path
+    OmitWhite,     // skip : a white edge
+    Endpoint,      // a vertex leaves the frontier as an endpoint
+    Unreachable,   // the lower edges cannot complete a cycle
+    LastLevel,     // no cycle at the last level
+    Next,          // go to the next level
+    Memory,        // out of the memory budget
+    NUM_REASONS
+  };
+
+  static const char* getReasonName(const int r)
+  {
+    static const char* names[] = {"branch", "backflow", "backward", "gray_twice", "cycle_fragment", "cycle_white",
+                                  "cycle", "upper", "omit_white", "endpoint", "unreachable", "last_level", "next",
+                                  "memory"};
+    return names[r];
+  }
+
+ private:
+
+  int m;                              // # levels
+  size_t node_size;                   // bytes per node
+  std::vector<long long> counts;      // counts[(level * 2 + value) * NUM_REASONS + reason]
+  std::vector<size_t> nodes;          // # nodes per level (non-reduced)
+  std::vector<size_t> reduced;        // # nodes per level (reduced)
+  std::vector<int> frontier;          // # frontier vertices per level
+
+ public:
+
+  NagareruStats(const int m, const size_t node_size=0)
+      : m(m), node_size(node_size), counts((m + 1) * 2 * NUM_REASONS, 0), nodes(m + 1, 0), reduced(m + 1, 0), frontier(m + 1, 0)
+  {
+  }
+
+  ////////////////////////////////////////
+  // record
+  ////////////////////////////////////////
+  void count(const int level, const int value, const Reason r)
+  {
+    long long& c = counts[(level * 2 + value) * NUM_REASONS + r];
+#pragma omp atomic
+    c++;
+  }
+
+  void setNodes(const int level, const size_t n)    { nodes[level] = n; }
+  void setReduced(const int level, const size_t n)  { reduced[level] = n; }
+  void setFrontier(const int level, const int n)    { frontier[level] = n; }
+
+  long long getCount(const int level, const int value, const int r) const
+  {
+    return counts[(level * 2 + value) * NUM_REASONS + r];
+  }
+
+  long long getCalls(const int level, const int value) const
+  {
+    long long c = 0;
+    for (int r = 0; r < NUM_REASONS; ++r) c += getCount(level, value, r);
+    return c;
+  }
+
+  ////////////////////////////////////////
+  // print as a table
+  ////////////////////////////////////////
+  void print(std::ostream& os=std::cout) const
+  {
+    os << std::setw(6) << "level" << std::setw(9) << "frontier" << std::setw(10) << "nodes"
+       << std::setw(12) << "bytes" << std::setw(10) << "reduced" << std::setw(12) << "calls";
+    for (int r = 0; r < NUM_REASONS; ++r) os << " " << std::setw(12) << getReasonName(r);
+    os << std::endl;
+
+    for (int level = m; level > 0; --level) {
+      os << std::setw(6) << level << std::setw(9) << frontier[level] << std::setw(10) << nodes[level]
+         << std::setw(12) << nodes[level] * node_size << std::setw(10) << reduced[level]
+         << std::setw(12) << getCalls(level, 0) + getCalls(level, 1);
+      for (int r = 0; r < NUM_REASONS; ++r) {
+        os << " " << std::setw(12) << getCount(level, 0, r) + getCount(level, 1, r);
+      }
+      os << std::endl;
+    }
+#if !NAGARERU_STATS
+    os << "(getChild counters are compiled out : make DEFS=-DNAGARERU_STATS=1)" << std::endl;
+#endif
+  }
+
+  ////////////////////////////////////////
+  // dump as JSON : a level per element, counts as [skip, take]
+  ////////////////////////////////////////
+  void dumpJSON(std::ostream& os) const
+  {
+    os << "{\"counters\":" << (NAGARERU_STATS ? "true" : "false") << ",\"levels\":[" << std::endl;
+    for (int level = m; level > 0; --level) {
+      os << "{\"level\":" << level << ",\"frontier\":" << frontier[level]
+         << ",\"nodes\":" << nodes[level] << ",\"bytes\":" << nodes[level] * node_size
+         << ",\"reduced\":" << reduced[level]
+         << ",\"calls\":[" << getCalls(level, 0) << "," << getCalls(level, 1) << "]";
+      for (int r = 0; r < NUM_REASONS; ++r) {
+        os << ",\"" << getReasonName(r) << "\":[" << getCount(level, 0, r) << "," << getCount(level, 1, r) << "]";
+      }
+      os << "}" << (level > 1 ? "," : "") << std::endl;
+    }
+    os << "]}" << std::endl;
+  }
+};
+
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+////////////////////////////////////////
+// include
+////////////////////////////////////////
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <tdzdd/DdSpec.hpp>
+#include <tdzdd/DdStructure.hpp>
+
+#include "FrontierManager.hpp"
+#include "NagareruProblem.hpp"
+
+
+////////////////////////////////////////
+// namespace
+////////////////////////////////////////
+namespace nagareru
+{
+
+////////////////////////////////////////
+// binary file of a solution ZDD (little endian)
+//   header : "NGRZ" | version (uint32) | problem hash (uint64) | W (uint32) | H (uint32)
+//            | edge order (uint32) | # levels m (uint32) | original edge id of level m..1 (uint32 x m)
+//   root   : level (uint32) | index (uint32)
+//   levels : for level 1..m, # nodes (uint32) and the 0/1-children of each node as level (uint32) | index (uint32)
+// a child (or the root) at level 0 is the 0-terminal (index 0) or the 1-terminal (index 1)
+////////////////////////////////////////
+static const char ZddMagic[] = "NGRZ";
+static const uint32_t ZddVersion = 1;
+
+void writeZddInt(std::ostream& os, const uint64_t v, const int bytes)
+{
+  char b[8];
+  for (int k = 0; k < bytes; ++k) b[k] = char((v >> (8 * k)) & 0xff);
+  os.write(b, bytes);
+}
+
+uint64_t readZddInt(std::istream& is, const int bytes)
+{
+  unsigned char b[8];
+  if (!is.read(reinterpret_cast<char*>(b), bytes)) throw std::runtime_error("truncated ZDD file");
+  uint64_t v = 0;
+  for (int k = 0; k < bytes; ++k) v |= (uint64_t)b[k] << (8 * k);
+  return v;
+}
+
+////////////////////////////////////////
+// save a (reduced) ZDD of P whose levels are the edges of fm
+////////////////////////////////////////
+void saveZdd(const std::string& file, const tdzdd::DdStructure<2>& D, const NagareruProblem& P, const FrontierManager& fm)
+{
+  std::ofstream ofs(file, std::ios::binary);
+  if (!ofs) throw std::runtime_error("cannot write " + file);
+
+  // header
+  const int m = fm.getEdgeSize();
+  const std::vector<int> eids = fm.getOriginalEdgeIds();
+  ofs.write(ZddMagic, 4);
+  writeZddInt(ofs, ZddVersion, 4);
+  writeZddInt(ofs, P.getHash(), 8);
+  writeZddInt(ofs, P.getW(), 4);
+  writeZddInt(ofs, P.getH(), 4);
+  writeZddInt(ofs, static_cast<int>(fm.getOrder()), 4);
+  writeZddInt(ofs, m, 4);
+  for (int level = m; level > 0; --level) {
+    writeZddInt(ofs, eids[level], 4);
+  }
+
+  // root
+  writeZddInt(ofs, D.root().row(), 4);
+  writeZddInt(ofs, D.root().col(), 4);
+
+  // levels
+  const tdzdd::NodeTableEntity<2>& table = *D.getDiagram();
+  for (int level = 1; level <= m; ++level) {
+    const size_t n = (level < table.numRows()) ? table[level].size() : 0;
+    writeZddInt(ofs, n, 4);
+    for (size_t j = 0; j < n; ++j) {
+      for (int b = 0; b < 2; ++b) {
+        writeZddInt(ofs, table[level][j].branch[b].row(), 4);
+        writeZddInt(ofs, table[level][j].branch[b].col(), 4);
+      }
+    }
+  }
+
+  if (!ofs) throw std::runtime_error("cannot write " + file);
+}
+
+////////////////////////////////////////
+// Zdd File Spec : a saved ZDD as a spec (state : the index of a node over all levels)
+////////////////////////////////////////
+class ZddFileSpec : public tdzdd::DdSpec<ZddFileSpec, uint64_t, 2>
+{
+  uint32_t root_level;
+  uint32_t root_index;
+  std::vector<uint64_t> base;     // base[level] : the index of the first node of level
+  std::vector<uint32_t> levels;   // levels[2 * node + b] : the level of the b-child of node
+  std::vector<uint32_t> indices;  // indices[2 * node + b] : its index in the level
+
+  // is (level, index) a node below upper
+  bool isValid(const uint32_t level, const uint32_t index, const int upper) const
+  {
+    if (level == 0) return index <= 1;
+    return level < (uint32_t)upper && base[level] + index < base[level + 1];
+  }
+
+  int getNode(uint64_t& s, const uint32_t level, const uint32_t index) const
+  {
+    if (level == 0) return (index != 0) ? -1 : 0;
+    s = base[level] + index;
+    return level;
+  }
+
+ public:
+
+  // read file and check that it is a ZDD of P whose levels are the edges of fm
+  ZddFileSpec(const std::string& file, const NagareruProblem& P, const FrontierManager& fm)
+  {
+    std::ifstream ifs(file, std::ios::binary);
+    if (!ifs) throw std::runtime_error("cannot open " + file);
+
+    // header
+    char magic[4];
+    if (!ifs.read(magic, 4) || std::string(magic, 4) != std::string(ZddMagic, 4) || readZddInt(ifs, 4) != ZddVersion) {
+      throw std::runtime_error("not a ZDD file (or another version) : " + file);
+    }
+    if (readZddInt(ifs, 8) != P.getHash() || readZddInt(ifs, 4) != (uint64_t)P.getW() || readZddInt(ifs, 4) != (uint64_t)P.getH()) {
+      throw std::runtime_error("the ZDD is of another problem : " + file);
+    }
+    const std::vector<int> eids = fm.getOriginalEdgeIds();
+    bool same = (readZddInt(ifs, 4) == (uint64_t)static_cast<int>(fm.getOrder()));
+    const int m = readZddInt(ifs, 4);
+    same = same && (m == fm.getEdgeSize());
+    for (int level = m; same && level > 0; --level) {
+      same = (readZddInt(ifs, 4) == (uint64_t)eids[level]);
+    }
+    if (!same) throw std::runtime_error("the ZDD is of another edge order : " + file);
+
+    // root
+    root_level = readZddInt(ifs, 4);
+    root_index = readZddInt(ifs, 4);
+
+    // levels
+    base.assign(m + 2, 0);
+    for (int level = 1; level <= m; ++level) {
+      const uint32_t n = readZddInt(ifs, 4);
+      base[level] = levels.size() / 2;
+      for (uint32_t j = 0; j < 2 * n; ++j) {
+        levels.push_back( readZddInt(ifs, 4) );
+        indices.push_back( readZddInt(ifs, 4) );
+      }
+    }
+    base[m + 1] = levels.size() / 2;
+
+    // the root and the children are at valid (and lower) levels
+    if (!isValid(root_level, root_index, m + 1)) throw std::runtime_error("invalid root : " + file);
+    for (int level = 1; level <= m; ++level) {
+      for (uint64_t k = 2 * base[level]; k < 2 * base[level + 1]; ++k) {
+        if (!isValid(levels[k], indices[k], level)) {
+          throw std::runtime_error("invalid child at level " + std::to_string(level) + " : " + file);
+        }
+      }
+    }
+  }
+
+  int getRoot(uint64_t& s) const
+  {
+    return getNode(s, root_level, root_index);
+  }
+
+  int getChild(uint64_t& s, const int level, const int value) const
+  {
+    const uint64_t k = 2 * s + value;
+    return getNode(s, levels[k], indices[k]);
+  }
+};
+
+////////////////////////////////////////
+// load a ZDD saved by saveZdd : a copy of the saved nodes, without the frontier method
+////////////////////////////////////////
+tdzdd::DdStructure<2> loadZdd(const std::string& file, const NagareruProblem& P, const FrontierManager& fm)
+{
+  const ZddFileSpec spec(file, P, fm);
+  return tdzdd::DdStructure<2>(spec);
+}
+
+}
@@ -0,0 +1,339 @@
+#include "main.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <regex>
+#include <glob.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+////////////////////////////////////////
+// benchmark of the solver over the datasets
+//   buckets : handcrafted and generated/rand_N_N
+//   samples : the seconds of each phase for each instance (median over repetitions)
+//   a bucket runs in a child process, so its peak RSS does not depend on the buckets before
+////////////////////////////////////////
+static const char* PhaseNames[] = {"parse", "graph", "frontier", "construct", "reduce", "cardinality", "total"};
+static const int NUM_PHASES = 7;
+
+struct Stat {
+  double median;
+  double p95;
+};
+
+Stat getStat(std::vector<double> v)
+{
+  Stat s = {0, 0};
+  if (v.empty()) return s;
+  std::sort(v.begin(), v.end());
+  s.median = (v.size() % 2 == 1) ? v[v.size()/2] : (v[v.size()/2 - 1] + v[v.size()/2]) / 2;
+  s.p95 = v[ std::max<int>(0, std::ceil(0.95 * v.size()) - 1) ];
+  return s;
+}
+
+// a bucket per line : "name":{"files":n,"errors":e,"peak_rss_kb":k,"parse":{"median":m,"p95":p},...}
+struct Bucket {
+  std::string name;
+  int files;
+  int errors;
+  long peak_rss_kb;
+  Stat stats[NUM_PHASES];
+};
+
+std::string toJSON(const Bucket& b)
+{
+  std::ostringstream os;
+  os << "\"" << b.name << "\":{\"files\":" << b.files << ",\"errors\":" << b.errors
+     << ",\"peak_rss_kb\":" << b.peak_rss_kb;
+  for (int p = 0; p < NUM_PHASES; ++p) {
+    os << ",\"" << PhaseNames[p] << "\":{\"median\":" << b.stats[p].median << ",\"p95\":" << b.stats[p].p95 << "}";
+  }
+  os << "}";
+  return os.str();
+}
+
+// a bucket of a line written by toJSON (false if line is not a bucket)
+bool parseBucket(const std::string& line, Bucket& b)
+{
+  const std::regex rb("^\"([^\"]+)\":\\{\"files\":([0-9]+),\"errors\":([0-9]+),\"peak_rss_kb\":([0-9]+)");
+  const std::regex rp("\"([a-z]+)\":\\{\"median\":([^,]+),\"p95\":([^}]+)\\}");
+  std::smatch m;
+  if (!std::regex_search(line, m, rb)) return false;
+  b.name = m[1];
+  b.files = std::stoi(m[2]);
+  b.errors = std::stoi(m[3]);
+  b.peak_rss_kb = std::stol(m[4]);
+  for (int p = 0; p < NUM_PHASES; ++p) b.stats[p].median = b.stats[p].p95 = 0;
+  for (std::sregex_iterator it(line.begin(), line.end(), rp), end; it != end; ++it) {
+    for (int p = 0; p < NUM_PHASES; ++p) {
+      if ((*it)[1] == PhaseNames[p]) {
+        b.stats[p].median = std::stod((*it)[2]);
+        b.stats[p].p95 = std::stod((*it)[3]);
+      }
+    }
+  }
+  return true;
+}
+
+std::vector<Bucket> readJSON(const std::string& file)
+{
+  std::vector<Bucket> buckets;
+  std::ifstream ifs(file);
+  if (!ifs) throw std::runtime_error("cannot open " + file);
+
+  std::string line;
+  Bucket b;
+  while (getline(ifs, line)) {
+    if (parseBucket(line, b)) buckets.push_back(b);
+  }
+  return buckets;
+}
+
+Bucket runBucket(const std::string& name, std::vector<std::string> files,
+                 const int warmup, const int reps, const int max_files, const EdgeOrder order)
+{
+  std::sort(files.begin(), files.end());
+  if (max_files > 0 && files.size() > max_files) files.resize(max_files);
+
+  Bucket b;
+  b.name = name;
+  b.files = files.size();
+  b.errors = 0;
+
+  // runs[p][i] : the seconds of phase p of files[i] for each repetition
+  std::vector< std::vector<double> > runs[NUM_PHASES];
+  for (int p = 0; p < NUM_PHASES; ++p) {
+    runs[p].resize(files.size());
+  }
+  for (int r = -warmup; r < reps; ++r) {
+    for (int i = 0; i < files.size(); ++i) {
+      const nagareru::SolveRecord rec = nagareru::solveFile(files[i], order);
+      if (r < 0) continue;
+      if (!rec.error.empty()) {
+        b.errors++;
+        continue;
+      }
+      const double t[NUM_PHASES - 1] = {rec.t_parse, rec.t_graph, rec.t_frontier,
+                                        rec.t_construct, rec.t_reduce, rec.t_cardinality};
+      double total = 0;
+      for (int p = 0; p < NUM_PHASES - 1; ++p) {
+        runs[p][i].push_back(t[p]);
+        total += t[p];
+      }
+      runs[NUM_PHASES - 1][i].push_back(total);
+    }
+  }
+
+  std::vector<double> samples[NUM_PHASES];
+  for (int p = 0; p < NUM_PHASES; ++p) {
+    for (int i = 0; i < files.size(); ++i) {
+      if (!runs[p][i].empty()) samples[p].push_back( getStat(runs[p][i]).median );
+    }
+  }
+  for (int p = 0; p < NUM_PHASES; ++p) {
+    b.stats[p] = getStat(samples[p]);
+  }
+  b.peak_rss_kb = nagareru::getPeakRSS() / 1024;
+  return b;
+}
+
+// runBucket in a child process : the peak RSS is that of the bucket alone
+Bucket runBucketProcess(const std::string& name, const std::vector<std::string>& files,
+                        const int warmup, const int reps, const int max_files, const EdgeOrder order)
+{
+  int fds[2];
+  if (pipe(fds) != 0) throw std::runtime_error("cannot create a pipe");
+  std::cout.flush();
+  std::cerr.flush();
+  const pid_t pid = fork();
+  if (pid < 0) throw std::runtime_error("cannot fork");
+
+  // child : write the bucket to the pipe
+  if (pid == 0) {
+    close(fds[0]);
+    const std::string s = toJSON( runBucket(name, files, warmup, reps, max_files, order) ) + "\n";
+    size_t done = 0;
+    while (done < s.size()) {
+      const ssize_t n = write(fds[1], s.data() + done, s.size() - done);
+      if (n <= 0) _exit(1);
+      done += n;
+    }
+    _exit(0);
+  }
+
+  // parent : read the bucket
+  close(fds[1]);
+  std::string s;
+  char buf[4096];
+  ssize_t n;
+  while ((n = read(fds[0], buf, sizeof(buf))) > 0) s.append(buf, n);
+  close(fds[0]);
+  int status;
+  waitpid(pid, &status, 0);
+
+  Bucket b;
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || !parseBucket(s, b)) {
+    throw std::runtime_error("bucket " + name + " failed");
+  }
+  return b;
+}
+
+// # regressions of cur against base : slower (or larger) by more than threshold
+int compare(const std::vector<Bucket>& base, const std::vector<Bucket>& cur, const double threshold, const double min_sec)
+{
+  int n = 0;
+  for (int i = 0; i < cur.size(); ++i) {
+    const Bucket* b = NULL;
+    for (int j = 0; j < base.size(); ++j) {
+      if (base[j].name == cur[i].name) b = &base[j];
+    }
+    if (b == NULL) {
+      std::cout << cur[i].name << " : not in the baseline" << std::endl;
+      continue;
+    }
+    for (int p = 0; p < NUM_PHASES; ++p) {
+      const double bs[2] = {b->stats[p].median, b->stats[p].p95};
+      const double cs[2] = {cur[i].stats[p].median, cur[i].stats[p].p95};
+      for (int k = 0; k < 2; ++k) {
+        const bool slow = (cs[k] > bs[k] * (1 + threshold) && cs[k] - bs[k] > min_sec);
+        if (slow) n++;
+        if (slow || k == 0) {
+          std::cout << (slow ? "REGRESSION " : "           ") << cur[i].name << " " << PhaseNames[p]
+                    << (k == 0 ? " median " : " p95 ") << bs[k] << " -> " << cs[k] << std::endl;
+        }
+      }
+    }
+    if (cur[i].peak_rss_kb > b->peak_rss_kb * (1 + threshold)) {
+      n++;
+      std::cout << "REGRESSION " << cur[i].name << " peak_rss_kb " << b->peak_rss_kb << " -> " << cur[i].peak_rss_kb << std::endl;
+    }
+  }
+  return n;
+}
+
+int main(int argc, char *argv[])
+{
+  ////////////////////////////////////////
+  // arguments
+  ////////////////////////////////////////
+  std::string data_dir = "../dataset";
+  std::string out_file = "";
+  std::string base_file = "";
+  int warmup = 1;
+  int reps = 5;
+  int max_files = 0;
+  double threshold = 0.20;
+  double min_sec = 1e-3;
+  EdgeOrder order = EdgeOrder::Best;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg(argv[i]);
+    if (arg == "--data" && i + 1 < argc) {
+      data_dir = argv[++i];
+    }
+    else if (arg == "--out" && i + 1 < argc) {
+      out_file = argv[++i];
+    }
+    else if (arg == "--compare" && i + 1 < argc) {
+      base_file = argv[++i];
+    }
+    else if (arg == "--warmup" && i + 1 < argc) {
+      warmup = atoi( argv[++i] );
+    }
+    else if (arg == "--reps" && i + 1 < argc) {
+      reps = atoi( argv[++i] );
+    }
+    else if (arg == "--max-files" && i + 1 < argc) {
+      max_files = atoi( argv[++i] );
+    }
+    else if (arg == "--threshold" && i + 1 < argc) {
+      threshold = atof( argv[++i] );
+    }
+    else if (arg == "--min-sec" && i + 1 < argc) {
+      min_sec = atof( argv[++i] );
+    }
+    else if (arg == "--order" && i + 1 < argc) {
+      const std::string name(argv[++i]);
+      for (int k = 0; k <= static_cast<int>(EdgeOrder::Best); ++k) {
+        if (name == EdgeOrderNames[k]) {
+          order = static_cast<EdgeOrder>(k);
+        }
+      }
+    }
+    else {
+      std::cout << "Options" << std::endl;
+      std::cout << "--data [string] : the dataset directory (default: ../dataset)" << std::endl;
+      std::cout << "--out [string] : the result file (default: stdout)" << std::endl;
+      std::cout << "--warmup [int] : # unmeasured runs per instance (default: 1)" << std::endl;
+      std::cout << "--reps [int] : # measured runs per instance (default: 5)" << std::endl;
+      std::cout << "--max-files [int] : # instances per bucket at most (0 = all)" << std::endl;
+      std::cout << "--order [row|column|diagonal|minwidth|best] : edge order" << std::endl;
+      std::cout << "--compare [string] : a baseline result file to compare with" << std::endl;
+      std::cout << "--threshold [double] : relative slowdown reported as a regression (default: 0.20)" << std::endl;
+      std::cout << "--min-sec [double] : absolute slowdown ignored as noise (default: 1e-3)" << std::endl;
+      exit(1);
+    }
+  }
+
+  ////////////////////////////////////////
+  // buckets
+  ////////////////////////////////////////
+  std::vector< std::pair<std::string, std::string> > dirs;
+  dirs.push_back( std::make_pair("handcrafted", data_dir + "/handcrafted") );
+  std::vector<std::string> gens;
+  glob_t g;
+  if (glob((data_dir + "/generated/rand_*").c_str(), GLOB_ONLYDIR, NULL, &g) == 0) {
+    gens.assign(g.gl_pathv, g.gl_pathv + g.gl_pathc);
+  }
+  globfree(&g);
+  std::vector< std::pair<int, std::string> > sorted;
+  for (int i = 0; i < gens.size(); ++i) {
+    const std::string name = gens[i].substr(gens[i].find_last_of("/") + 1);
+    sorted.push_back( std::make_pair(atoi(name.substr(5).c_str()), name) );
+  }
+  std::sort(sorted.begin(), sorted.end());
+  for (int i = 0; i < sorted.size(); ++i) {
+    dirs.push_back( std::make_pair(sorted[i].second, data_dir + "/generated/" + sorted[i].second) );
+  }
+
+  ////////////////////////////////////////
+  // run
+  ////////////////////////////////////////
+  std::vector<Bucket> buckets;
+  for (int i = 0; i < dirs.size(); ++i) {
+    const std::vector<std::string> files = nagareru::getBatchFiles(dirs[i].second);
+    if (files.empty()) continue;
+    buckets.push_back( runBucketProcess(dirs[i].first, files, warmup, reps, max_files, order) );
+    std::cerr << "bench : " << toJSON(buckets.back()) << std::endl;
+  }
+
+  std::ofstream fos;
+  if (out_file != "") fos.open(out_file);
+  std::ostream& os = (out_file != "") ? fos : std::cout;
+  os << "{" << std::endl;
+  os << "\"config\":{\"warmup\":" << warmup << ",\"reps\":" << reps << ",\"max_files\":" << max_files
+     << ",\"order\":\"" << EdgeOrderNames[ static_cast<int>(order) ] << "\"}," << std::endl;
+  long peak_rss_kb = 0;
+  for (int i = 0; i < buckets.size(); ++i) {
+    peak_rss_kb = std::max(peak_rss_kb, buckets[i].peak_rss_kb);
+  }
+  os << "\"peak_rss_kb\":" << peak_rss_kb << "," << std::endl;
+  os << "\"buckets\":{" << std::endl;
+  for (int i = 0; i < buckets.size(); ++i) {
+    os << toJSON(buckets[i]) << (i + 1 < buckets.size() ? "," : "") << std::endl;
+  }
+  os << "}" << std::endl;
+  os << "}" << std::endl;
+  if (out_file != "") fos.close();
+
+  ////////////////////////////////////////
+  // compare
+  ////////////////////////////////////////
+  if (base_file != "") {
+    const int n = compare(readJSON(base_file), buckets, threshold, min_sec);
+    std::cout << "# regressions : " << n << std::endl;
+    return (n > 0) ? 2 : 0;
+  }
+
+  return 0;
+}
@@ -11,14 +11,32 @@ int main(int argc, char *argv[])
   bool flag_print = false;
   bool flag_rand  = false;
   bool flag_cnf   = false;
+  bool flag_count = false;
+  bool flag_stats = false;
+  bool flag_dedup = false;
 
   std::random_device seed_gen;
   unsigned int seed = seed_gen();
   int W = 5;
   int H = 5;
   int N = 0;
+  int T = 1;
+  int K = 0;
+  size_t max_solutions = 0;
+  size_t mem_limit = 0;
+  std::string solution_format = "";
+  EdgeOrder order = EdgeOrder::Best;
 
   std::string problem_file = "example.txt";
+  std::string out_dir = ".";
+  std::string batch_path = "";
+  std::string out_file = "";
+  std::string format = "jsonl";
+  std::string stats_file = "";
+  std::string pack_file = "";
+  std::string unpack_file = "";
+  std::string zdd_out_file = "";
+  std::string zdd_in_file = "";
 
   for (int i = 1; i < argc; ++i) {
     const std::string arg(argv[i]);
@@ -34,6 +52,37 @@ int main(int argc, char *argv[])
     else if (arg == "--cnf") {
       flag_cnf = true;
     }
+    else if (arg == "--count") {
+      flag_count = true;
+      if (i + 1 < argc && std::isdigit(argv[i+1][0])) K = atoi( argv[++i] );
+    }
+    else if (arg == "--stats") {
+      flag_stats = true;
+    }
+    else if (arg == "--stats-json") {
+      stats_file = argv[++i];
+    }
+    else if (arg == "--out-dir") {
+      out_dir = argv[++i];
+    }
+    else if (arg == "--batch") {
+      batch_path = argv[++i];
+    }
+    else if (arg == "--dedup") {
+      flag_dedup = true;
+    }
+    else if (arg == "--pack") {
+      pack_file = argv[++i];
+    }
+    else if (arg == "--unpack") {
+      unpack_file = argv[++i];
+    }
+    else if (arg == "--out") {
+      out_file = argv[++i];
+    }
+    else if (arg == "--format" && i + 1 < argc && (std::string(argv[i+1]) == "jsonl" || std::string(argv[i+1]) == "csv")) {
+      format = argv[++i];
+    }
     else if (arg == "--width") {
       W = atoi( argv[++i] );
     }
@@ -49,18 +98,63 @@ int main(int argc, char *argv[])
     else if (arg == "--file") {
       problem_file = argv[++i];
     }
+    else if (arg == "--max-solutions") {
+      max_solutions = atol( argv[++i] );
+    }
+    else if (arg == "--solutions" && i + 1 < argc && (std::string(argv[i+1]) == "mask" || std::string(argv[i+1]) == "cells")) {
+      solution_format = argv[++i];
+    }
+    else if (arg == "--save-zdd") {
+      zdd_out_file = argv[++i];
+    }
+    else if (arg == "--load-zdd") {
+      zdd_in_file = argv[++i];
+    }
+    else if (arg == "--mem-limit") {
+      mem_limit = nagareru::parseBytes( argv[++i] );
+    }
+    else if (arg == "--threads") {
+      T = atoi( argv[++i] );
+    }
+    else if (arg == "--order" && i + 1 < argc) {
+      const std::string name(argv[++i]);
+      for (int k = 0; k <= static_cast<int>(EdgeOrder::Best); ++k) {
+        if (name == EdgeOrderNames[k]) {
+          order = static_cast<EdgeOrder>(k);
+        }
+      }
+    }
     else {
       std::cout << "Options" << std::endl;
       std::cout << "--file [string] : the name of a problem file" << std::endl;
       std::cout << "--print : print the problem" << std::endl;
       std::cout << "--dump  : export various dot files" << std::endl;
       std::cout << "--cnf   : export the cnf file" << std::endl;
+      std::cout << "--count : only count solutions without the ZDD (less memory, no --dump)" << std::endl;
+      std::cout << "--solutions [mask|cells] : export solutions one per line" << std::endl;
+      std::cout << "--max-solutions [int] : # solutions exported at most (0 = all)" << std::endl;
+      std::cout << "--threads [int] : # threads for ZDD construction" << std::endl;
+      std::cout << "--save-zdd [string] : save the reduced ZDD as a binary file" << std::endl;
+      std::cout << "--load-zdd [string] : load the ZDD saved by --save-zdd instead of constructing it" << std::endl;
+      std::cout << "--stats : print per-level statistics of ZDD construction" << std::endl;
+      std::cout << "--mem-limit [bytes] : stop (exit code 3) once the nodes and states of a construction exceed it, e.g. 512M, 2G" << std::endl;
+      std::cout << "--stats-json [string] : export per-level statistics as JSON" << std::endl;
+      std::cout << "--order [row|column|diagonal|minwidth|best] : edge order" << std::endl;
+      std::cout << "<<<< batch >>>>" << std::endl;
+      std::cout << "--batch [string] : solve all problems in a directory, glob, list file, corpus or pzprv3 stream (- for stdin)" << std::endl;
+      std::cout << "--pack [string] : convert the problems of --batch into a corpus instead of solving them" << std::endl;
+      std::cout << "--unpack [string] : convert a corpus into pzprv3 files in --out-dir" << std::endl;
+      std::cout << "--dedup : list the problems of --batch equal up to rotation and reflection instead of solving them" << std::endl;
+      std::cout << "--format [jsonl|csv] : format of the records of --batch" << std::endl;
+      std::cout << "--out [string] : the file of the records of --batch (default: stdout)" << std::endl;
       std::cout << "<<<< generation >>>>" << std::endl;
       std::cout << "--rand : create a random instance" << std::endl;
       std::cout << "--width  [int] : width" << std::endl;
       std::cout << "--height [int] : height" << std::endl;
       std::cout << "--init   [int] : # black cells on init board" << std::endl;
       std::cout << "--seed   [int] : seed of a random instance" << std::endl;
+      std::cout << "--count  [int] : # instances generated into --out-dir" << std::endl;
+      std::cout << "--out-dir [string] : the directory of generated instances" << std::endl;
       exit(1);
     }
   }
@@ -76,12 +170,154 @@ int main(int argc, char *argv[])
   std::string board_file = base + ".dot";
   std::string graph_dot_file = base + "_graph.dot";
   std::string zdd_file= base + "_zdd.dot";
+  std::string solutions_file = base + "_solutions.txt";
+
+  // threads
+  const bool use_mp = (T > 1);
+#ifdef _OPENMP
+  if (use_mp) omp_set_num_threads(T);
+#else
+  if (use_mp) std::cerr << "warning : compiled without OpenMP, --threads is ignored" << std::endl;
+#endif
+
+
+  ////////////////////////////////////////
+  // convert problems from / into a corpus
+  ////////////////////////////////////////
+  if (pack_file != "" || unpack_file != "") {
+    int num_errors = 0;
+    try {
+      if (pack_file != "") {
+        const std::vector<std::string> files = nagareru::getBatchFiles(batch_path);
+        num_errors = nagareru::packCorpus(files, pack_file);
+        std::cout << "# packed : " << files.size() - num_errors << " (" << pack_file << ")" << std::endl;
+      }
+      else {
+        num_errors = nagareru::unpackCorpus(unpack_file, out_dir);
+        std::cout << "# unpacked : " << nagareru::NagareruCorpus(unpack_file).size() - num_errors << " (" << out_dir << ")" << std::endl;
+      }
+    }
+    catch (const std::exception& e) {
+      std::cerr << "error : " << e.what() << std::endl;
+      return 1;
+    }
+    return (num_errors > 0) ? 1 : 0;
+  }
+
+  ////////////////////////////////////////
+  // solve a batch of problems : one record per problem, nothing else
+  ////////////////////////////////////////
+  if (batch_path != "") {
+    std::ofstream fos;
+    if (out_file != "") {
+      fos.open(out_file);
+      if (!fos) {
+        std::cerr << "error : cannot write " << out_file << std::endl;
+        return 1;
+      }
+    }
+    std::ostream& os = (out_file != "") ? fos : std::cout;
+    if (flag_dedup) {
+      int num_errors = 0;
+      try {
+        const size_t n = nagareru::dedupBatch(batch_path, os, num_errors);
+        std::cerr << "# unique : " << n << std::endl;
+      }
+      catch (const std::exception& e) {
+        std::cerr << "error : " << e.what() << std::endl;
+        return 1;
+      }
+      return (num_errors > 0) ? 1 : 0;
+    }
+    if (batch_path == "-" || nagareru::isPzprvFile(batch_path)) {
+      std::ifstream ifs;
+      if (batch_path != "-") ifs.open(batch_path);
+      nagareru::NagareruReader reader((batch_path == "-") ? std::cin : ifs);
+      const int num_errors = nagareru::solveBatch(reader, (batch_path == "-") ? "stdin" : batch_path, os, format == "csv", order, use_mp, mem_limit);
+      if (num_errors > 0) std::cerr << "# errors : " << num_errors << " / " << reader.getNumRecords() << std::endl;
+      return (num_errors > 0) ? 1 : 0;
+    }
+    if (nagareru::isCorpusFile(batch_path)) {
+      try {
+        const nagareru::NagareruCorpus corpus(batch_path);
+        const int num_errors = nagareru::solveBatch(corpus, batch_path, os, format == "csv", order, use_mp, mem_limit);
+        if (num_errors > 0) std::cerr << "# errors : " << num_errors << " / " << corpus.size() << std::endl;
+        return (num_errors > 0) ? 1 : 0;
+      }
+      catch (const std::exception& e) {
+        std::cerr << "error : " << e.what() << std::endl;
+        return 1;
+      }
+    }
+    const std::vector<std::string> files = nagareru::getBatchFiles(batch_path);
+    const int num_errors = nagareru::solveBatch(files, os, format == "csv", order, use_mp, mem_limit);
+    if (num_errors > 0) std::cerr << "# errors : " << num_errors << " / " << files.size() << std::endl;
+    return (num_errors > 0) ? 1 : 0;
+  }
 
+  ////////////////////////////////////////
+  // generate K instances
+  ////////////////////////////////////////
+  if (flag_rand && K > 0) {
+    std::cout << "////////////////////////////////////////" << std::endl;
+    std::cout << "// Random Generation (batch)" << std::endl;
+    std::cout << "////////////////////////////////////////" << std::endl;
+    std::cout << "Output Dir   : " << out_dir << std::endl;
+    std::cout << "# Instances  : " << K << std::endl;
+    std::cout << "Board Width  : " << W << std::endl;
+    std::cout << "Board Height : " << H << std::endl;
+    std::cout << "Init # Cells : " << N << std::endl;
+    std::cout << "Seed         : " << seed << std::endl;
+    std::cout << "# threads    : " << T << std::endl;
+
+    mkdir(out_dir.c_str(), 0755);
+    const std::string manifest_file = out_dir + "/manifest.txt";
+    std::ofstream mos(manifest_file);
+    if (!mos) {
+      std::cerr << "error : cannot write " << manifest_file << std::endl;
+      return 1;
+    }
+    mos << "# index seed file count_calls seconds" << std::endl;
+
+    ////////////////////////////////////////
+    // Generate instances k = 1..K on T threads
+    //   the k-th instance only depends on (seed, k), and each line of the
+    //   manifest is written when the instance is finished
+    ////////////////////////////////////////
+#pragma omp parallel for schedule(dynamic, 1) if(use_mp)
+    for (int k = 1; k <= K; ++k) {
+      const auto start = std::chrono::steady_clock::now();
+      const unsigned int s = nagareru::getBatchSeed(seed, k);
+      const std::string name = "rand_" + std::to_string(W) + "_" + std::to_string(H) + "_" + std::to_string(k);
+      const std::string file = out_dir + "/" + name + ".txt";
+
+      // skip the instance if it cannot be checked within --mem-limit
+      nagareru::NagareruProblemGenerator g(s, flag_print, false, mem_limit);
+      bool skipped = false;
+      try {
+        nagareru::NagareruProblem R = g.generate(W, H, N);
+        R.dump(file);
+        if (flag_cnf) R.dumpCNF(out_dir + "/" + name + ".cnf");
+      }
+      catch (const nagareru::MemoryLimitExceeded& e) {
+        skipped = true;
+      }
+      const std::chrono::duration<double> sec = std::chrono::steady_clock::now() - start;
+
+#pragma omp critical
+      {
+        mos << k << " " << s << " " << (skipped ? "skipped" : file) << " " << g.getNumCallCountSolutions() << " " << sec.count() << std::endl;
+        std::cout << (skipped ? "skipped : " : "done : ") << file << std::endl;
+      }
+    }
+    mos.close();
+    std::cout << "Manifest     : " << manifest_file << std::endl;
+  }
 
   ////////////////////////////////////////
   // generate
   ////////////////////////////////////////
-  if (flag_rand) {
+  else if (flag_rand) {
     std::cout << "////////////////////////////////////////" << std::endl;
     std::cout << "// Random Generation" << std::endl;
     std::cout << "////////////////////////////////////////" << std::endl;
@@ -95,10 +331,17 @@ int main(int argc, char *argv[])
     ////////////////////////////////////////
     // Generate a random problem
     ////////////////////////////////////////
-    nagareru::NagareruProblemGenerator g(seed, flag_print);
-    nagareru::NagareruProblem R = g.generate(W, H, N);
-    R.dump(problem_file);
-    R.dumpCNF(cnf_file);
+    nagareru::NagareruProblemGenerator g(seed, flag_print, use_mp, mem_limit);
+    try {
+      nagareru::NagareruProblem R = g.generate(W, H, N);
+      R.dump(problem_file);
+      R.dumpCNF(cnf_file);
+    }
+    catch (const nagareru::MemoryLimitExceeded& e) {
+      std::cout << "# memory limit exceeded : skipped" << std::endl;
+      std::cout << "# count call : " << g.getNumCallCountSolutions() << std::endl;
+      return nagareru::EXIT_MEMORY_LIMIT;
+    }
     std::cout << "# count call : " << g.getNumCallCountSolutions() << std::endl;
   }
 
@@ -110,20 +353,19 @@ int main(int argc, char *argv[])
     std::cout << "// Solving" << std::endl;
     std::cout << "////////////////////////////////////////" << std::endl;
     std::cout << "Problem File : " << problem_file << std::endl;
+    std::cout << "# threads    : " << T << std::endl;
 
     ////////////////////////////////////////
     // Read a problem
     ////////////////////////////////////////
     nagareru::NagareruProblem P(problem_file);
     if (flag_print) P.print();
-    P.dumpGraph(graph_lst_file);
 
 
     ////////////////////////////////////////
-    // Load the input graph G
+    // Construct the input graph G
     ////////////////////////////////////////
-    tdzdd::Graph G;
-    G.readEdges(graph_lst_file);
+    const tdzdd::Graph G = P.getGraph();
     std::cout << "# board nodes : " << G.vertexSize() << std::endl;
     std::cout << "# board edges : " << G.edgeSize() << std::endl;
 
@@ -131,12 +373,95 @@ int main(int argc, char *argv[])
     ////////////////////////////////////////
     // Execute the frontier method */
     ////////////////////////////////////////
-    nagareru::NagareruSpec spec(P, G);
-    DdStructure<2> D = tdzdd::DdStructure<2>(spec);
-    D.zddReduce();
-    std::cout << "# zdd nodes (non-reduced) : " << D.size() << std::endl;
+    nagareru::NagareruSpec spec(P, G, order);
+    const FrontierManager& fm = spec.getFrontierManager();
+    std::cout << "# frontier width : " << fm.getWidth()
+              << " (" << EdgeOrderNames[ static_cast<int>(fm.getOrder()) ] << ")" << std::endl;
+
+    // memory budget
+    nagareru::MemoryBudget budget(mem_limit);
+    if (mem_limit > 0) spec.setMemoryBudget(&budget);
+
+    if (flag_count) {
+      nagareru::NagareruCounter counter(spec);
+      const std::string cnt = counter.count();
+      std::cout << "# max states per level : " << counter.getMaxStates() << std::endl;
+      std::cout << "# peak RSS : " << nagareru::getPeakRSS() << " bytes" << std::endl;
+      if (budget.isExceeded()) {
+        std::cout << "# memory limit exceeded : level " << budget.getExceededLevel()
+                  << " (limit " << mem_limit << " bytes)" << std::endl;
+        return nagareru::EXIT_MEMORY_LIMIT;
+      }
+      std::cout << "# solutions : " << cnt << std::endl;
+      if (flag_cnf) P.dumpCNF(cnf_file);
+      return 0;
+    }
+
+    // per-level statistics
+    const bool use_stats = (flag_stats || stats_file != "");
+    nagareru::NagareruStats stats(fm.getEdgeSize(), sizeof(tdzdd::Node<2>));
+    if (use_stats) spec.setStats(&stats);
+
+    DdStructure<2> D;
+    if (zdd_in_file != "") {
+      // reuse a saved ZDD instead of the construction
+      try {
+        D = nagareru::loadZdd(zdd_in_file, P, fm);
+      }
+      catch (const std::exception& e) {
+        std::cerr << "error : " << e.what() << std::endl;
+        return 1;
+      }
+      std::cout << "# zdd loaded : " << zdd_in_file << std::endl;
+    }
+    else {
+      D = tdzdd::DdStructure<2>(spec, use_mp);
+      std::cout << "# zdd nodes (non-reduced) : " << D.size() << std::endl;
+      std::cout << "# zdd bytes (non-reduced) : " << D.size() * sizeof(tdzdd::Node<2>) << std::endl;
+      std::cout << "# peak RSS : " << nagareru::getPeakRSS() << " bytes" << std::endl;
+      if (use_stats) {
+        const tdzdd::NodeTableEntity<2>& table = *D.getDiagram();
+        for (int level = 1; level < table.numRows(); ++level) {
+          stats.setNodes(level, table[level].size());
+        }
+        for (int level = 1; level <= fm.getEdgeSize(); ++level) {
+          stats.setFrontier(level, fm.getF(level).size());
+        }
+      }
+
+      // stop with the statistics so far
+      if (budget.isExceeded()) {
+        std::cout << "# memory limit exceeded : level " << budget.getExceededLevel()
+                  << " (limit " << mem_limit << " bytes)" << std::endl;
+        if (flag_stats) stats.print();
+        if (stats_file != "") {
+          std::ofstream jos(stats_file);
+          stats.dumpJSON(jos);
+          jos.close();
+        }
+        return nagareru::EXIT_MEMORY_LIMIT;
+      }
+      D.zddReduce();
+    }
     std::cout << "# zdd nodes (reduced)     : " << D.size() << std::endl;
     std::cout << "# solutions : " << D.zddCardinality() << std::endl;
+    if (zdd_out_file != "") {
+      nagareru::saveZdd(zdd_out_file, D, P, fm);
+      std::cout << "# zdd saved : " << zdd_out_file << std::endl;
+    }
+
+    if (use_stats) {
+      const tdzdd::NodeTableEntity<2>& table = *D.getDiagram();
+      for (int level = 1; level < table.numRows(); ++level) {
+        stats.setReduced(level, table[level].size());
+      }
+      if (flag_stats) stats.print();
+      if (stats_file != "") {
+        std::ofstream jos(stats_file);
+        stats.dumpJSON(jos);
+        jos.close();
+      }
+    }
 
 
     ////////////////////////////////////////
@@ -151,6 +476,7 @@ int main(int argc, char *argv[])
       P.dumpBoard(board_file);
 
       // graph
+      P.dumpGraph(graph_lst_file);
       std::ofstream gos(graph_dot_file);
       G.dump(gos);
       gos.close();
@@ -161,7 +487,14 @@ int main(int argc, char *argv[])
       zos.close();
 
       // solutions
-      P.dumpSolutions(D, base);
+      P.dumpSolutions(D, base, fm.getOriginalEdgeIds(), max_solutions);
+    }
+
+    if (solution_format != "") {
+      std::ofstream sos(solutions_file);
+      const size_t n = P.dumpSolutionLines(D, sos, fm.getOriginalEdgeIds(), solution_format == "cells", max_solutions);
+      sos.close();
+      std::cout << "# exported solutions : " << n << " (" << solutions_file << ")" << std::endl;
     }
   }
 }
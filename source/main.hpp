@@ -4,6 +4,12 @@
 #include <iostream>
 #include <fstream>
 #include <time.h>
+#include <chrono>
+#include <cctype>
+#include <sys/stat.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 // tdzdd
 #include <tdzdd/DdSpec.hpp>
@@ -14,4 +20,11 @@
 #include "NagareruSpec.hpp"
 #include "NagareruProblem.hpp"
 #include "NagareruProblemGenerator.hpp"
+#include "NagareruCounter.hpp"
+#include "NagareruStats.hpp"
+#include "NagareruMemory.hpp"
+#include "NagareruReader.hpp"
+#include "NagareruCorpus.hpp"
+#include "NagareruBatch.hpp"
+#include "NagareruZdd.hpp"
 #include "FrontierManager.hpp"